@@ -8,11 +8,22 @@
 #include "threads/thread.h"
 #ifdef USERPROG
 #include "userprog/exception.h"
+#include "userprog/pagedir.h"
 #endif
 #ifdef FILESYS
 #include "devices/block.h"
 #include "filesys/filesys.h"
 #endif
+#ifdef VM
+#include "vm/frame.h"
+#include "vm/oom.h"
+#include "vm/prepage.h"
+#include "vm/region.h"
+#include "vm/repl.h"
+#include "vm/vmstat.h"
+#include "vm/ws.h"
+#include "vm/zswap.h"
+#endif
 
 /* Keyboard control register port. */
 #define CONTROL_REG 0x64
@@ -134,5 +145,16 @@ print_stats (void)
   kbd_print_stats ();
 #ifdef USERPROG
   exception_print_stats ();
+  pagedir_print_stats ();
+#endif
+#ifdef VM
+  vmstat_print_stats ();
+  frame_print_stats ();
+  repl_print_stats ();
+  zswap_print_stats ();
+  ws_print_stats ();
+  prepage_print_stats ();
+  region_print_stats ();
+  oom_print_stats ();
 #endif
 }
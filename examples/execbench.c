@@ -0,0 +1,50 @@
+/* execbench.c
+
+   Process teardown benchmark.  Usage: execbench ITERS
+
+   Runs ITERS children one after the other, each of which dirties
+   CHILD_PAGES pages of BSS and exits.  If exiting processes leaked
+   their frames or swap slots, exec would start failing once memory
+   runs out; the benchmark reports the iteration at which it did. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+
+#define CHILD_PAGES 16
+
+static char buf[CHILD_PAGES * 4096];
+
+int
+main (int argc, char *argv[])
+{
+  int iters, n;
+
+  if (argc == 2 && !strcmp (argv[1], "-c"))
+    {
+      /* Child: leave some dirty anonymous memory behind. */
+      memset (buf, 'x', sizeof buf);
+      return EXIT_SUCCESS;
+    }
+
+  if (argc != 2)
+    {
+      printf ("usage: execbench ITERS\n");
+      return EXIT_FAILURE;
+    }
+
+  iters = atoi (argv[1]);
+  for (n = 0; n < iters; n++)
+    {
+      pid_t pid = exec ("execbench -c");
+      if (pid == PID_ERROR || wait (pid) != EXIT_SUCCESS)
+        {
+          printf ("execbench: child %d of %d failed\n", n + 1, iters);
+          return EXIT_FAILURE;
+        }
+    }
+
+  printf ("execbench: %d children run and reaped\n", iters);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,62 @@
+/* fabench.c
+
+   Fault-around benchmark.  Usage: fabench ITERS
+
+   Runs ITERS children one after the other.  Each child reads one byte
+   of every page of a TEXT_PAGES page read-only table, as a large
+   program touches its code while starting up, and then writes its
+   first output.  The kernel's timer ticks over the whole run measure
+   exec to first output; the last child also prints its page faults. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+
+#define TEXT_PAGES 64
+
+/* Non-zero, so it is stored in the executable's read-only segment. */
+static const char text[TEXT_PAGES * 4096] = { 1 };
+
+int
+main (int argc, char *argv[])
+{
+  int iters, n;
+
+  if (argc == 2 && (!strcmp (argv[1], "-c") || !strcmp (argv[1], "-v")))
+    {
+      /* Child: touch the read-only segment, then first output. */
+      volatile const char *p = text;
+      struct vmstat st;
+      int sum = 0;
+      size_t i;
+
+      for (i = 0; i < sizeof text; i += 4096)
+        sum += p[i];
+      printf ("child up\n");
+      if (!strcmp (argv[1], "-v") && vmstat (&st, false))
+        printf ("fabench: %d pages touched, %lld major, %lld minor "
+                "faults\n", TEXT_PAGES, st.major_faults, st.minor_faults);
+      return sum == 1 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+  if (argc != 2)
+    {
+      printf ("usage: fabench ITERS\n");
+      return EXIT_FAILURE;
+    }
+
+  iters = atoi (argv[1]);
+  for (n = 0; n < iters; n++)
+    {
+      pid_t pid = exec (n == iters - 1 ? "fabench -v" : "fabench -c");
+      if (pid == PID_ERROR || wait (pid) != EXIT_SUCCESS)
+        {
+          printf ("fabench: child %d of %d failed\n", n + 1, iters);
+          return EXIT_FAILURE;
+        }
+    }
+
+  printf ("fabench: %d children run and reaped\n", iters);
+  return EXIT_SUCCESS;
+}
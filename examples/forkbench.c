@@ -0,0 +1,61 @@
+/* forkbench.c
+
+   Fork-exit microbenchmark.  Usage: forkbench MAPPED TOUCHED ITERS
+
+   Fills MAPPED kB of memory, then ITERS times forks a child that
+   writes TOUCHED kB of it and exits, waiting for each child.  With
+   copy-on-write fork the run time follows TOUCHED, not MAPPED. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+
+#define MAX_KB 1024
+
+static char buf[MAX_KB * 1024];
+
+int
+main (int argc, char *argv[])
+{
+  size_t mapped, touched, i;
+  int iters, n;
+
+  if (argc != 4)
+    {
+      printf ("usage: forkbench MAPPED TOUCHED ITERS\n");
+      return EXIT_FAILURE;
+    }
+
+  mapped = atoi (argv[1]);
+  touched = atoi (argv[2]);
+  iters = atoi (argv[3]);
+  if (mapped > MAX_KB || touched > mapped)
+    {
+      printf ("forkbench: need TOUCHED <= MAPPED <= %d\n", MAX_KB);
+      return EXIT_FAILURE;
+    }
+
+  memset (buf, 1, mapped * 1024);
+
+  for (n = 0; n < iters; n++)
+    {
+      pid_t pid = fork ();
+      if (pid == 0)
+        {
+          for (i = 0; i < touched * 1024; i += 4096)
+            buf[i] = 2;
+          exit (0);
+        }
+      if (pid == PID_ERROR)
+        {
+          printf ("forkbench: fork failed\n");
+          return EXIT_FAILURE;
+        }
+      wait (pid);
+    }
+
+  printf ("forkbench: %d forks, %zu kB mapped, %zu kB touched\n",
+          iters, mapped, touched);
+  return EXIT_SUCCESS;
+}
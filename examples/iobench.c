@@ -0,0 +1,67 @@
+/* iobench.c
+
+   Syscall buffer microbenchmark.  Usage: iobench BUFSIZE ITERS
+
+   Writes a 64 kB file with BUFSIZE byte write calls, then reads it
+   back ITERS times with BUFSIZE byte read calls.  The kernel checks
+   and pins syscall buffers a page at a time, so the cost per byte
+   falls as BUFSIZE grows. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+
+#define FILE_SIZE (64 * 1024)
+
+static char buf[FILE_SIZE];
+
+int
+main (int argc, char *argv[])
+{
+  size_t bufsize, ofs;
+  int iters, n, fd;
+
+  if (argc != 3)
+    {
+      printf ("usage: iobench BUFSIZE ITERS\n");
+      return EXIT_FAILURE;
+    }
+
+  bufsize = atoi (argv[1]);
+  iters = atoi (argv[2]);
+  if (bufsize == 0 || bufsize > FILE_SIZE)
+    {
+      printf ("iobench: need 0 < BUFSIZE <= %d\n", FILE_SIZE);
+      return EXIT_FAILURE;
+    }
+
+  memset (buf, 'x', sizeof buf);
+  if (!create ("iobench.dat", FILE_SIZE))
+    {
+      printf ("iobench: create failed\n");
+      return EXIT_FAILURE;
+    }
+  fd = open ("iobench.dat");
+  if (fd < 0)
+    {
+      printf ("iobench: open failed\n");
+      return EXIT_FAILURE;
+    }
+
+  for (ofs = 0; ofs < FILE_SIZE; ofs += bufsize)
+    write (fd, buf + ofs, ofs + bufsize > FILE_SIZE ? FILE_SIZE - ofs : bufsize);
+
+  for (n = 0; n < iters; n++)
+    {
+      seek (fd, 0);
+      for (ofs = 0; ofs < FILE_SIZE; ofs += bufsize)
+        read (fd, buf + ofs,
+              ofs + bufsize > FILE_SIZE ? FILE_SIZE - ofs : bufsize);
+    }
+  close (fd);
+
+  printf ("iobench: %d reads of %d kB in %zu byte calls\n",
+          iters, FILE_SIZE / 1024, bufsize);
+  return EXIT_SUCCESS;
+}
@@ -6,6 +6,9 @@
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
 #include "threads/malloc.h"
+#ifdef VM
+#include "vm/prepage.h"
+#endif
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
@@ -314,6 +317,12 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
     }
   free (bounce);
 
+#ifdef VM
+  /* Startup pages recorded for a changed executable are stale. */
+  if (bytes_written > 0)
+    prepage_invalidate (inode);
+#endif
+
   return bytes_written;
 }
 
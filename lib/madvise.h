@@ -0,0 +1,12 @@
+#ifndef __LIB_MADVISE_H
+#define __LIB_MADVISE_H
+
+/* Advice for the madvise system call.  NORMAL, RANDOM and SEQUENTIAL
+   stay with the pages, WILLNEED and DONTNEED act on them once. */
+#define MADV_NORMAL 0           /* No special treatment. */
+#define MADV_RANDOM 1           /* Random access, no readahead. */
+#define MADV_SEQUENTIAL 2       /* Sequential access, reclaim behind. */
+#define MADV_WILLNEED 3         /* Read the pages in now. */
+#define MADV_DONTNEED 4         /* Discard the pages now. */
+
+#endif /* lib/madvise.h */
@@ -28,7 +28,13 @@ enum
     SYS_MKDIR,                  /* Create a directory. */
     SYS_READDIR,                /* Reads a directory entry. */
     SYS_ISDIR,                  /* Tests if a fd represents a directory. */
-    SYS_INUMBER                 /* Returns the inode number for a fd. */
+    SYS_INUMBER,                /* Returns the inode number for a fd. */
+
+    /* Extensions. */
+    SYS_FORK,                   /* Duplicate the calling process. */
+    SYS_WSINFO,                 /* Working set of the calling process. */
+    SYS_VMSTAT,                 /* Virtual memory counters. */
+    SYS_MADVISE                 /* Advise on use of a memory range. */
   };
 
 #endif /* lib/syscall-nr.h */
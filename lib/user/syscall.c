@@ -182,3 +182,27 @@ inumber (int fd)
 {
   return syscall1 (SYS_INUMBER, fd);
 }
+
+pid_t
+fork (void)
+{
+  return syscall0 (SYS_FORK);
+}
+
+bool
+wsinfo (struct wsinfo *info)
+{
+  return syscall1 (SYS_WSINFO, info);
+}
+
+bool
+vmstat (struct vmstat *st, bool global)
+{
+  return syscall2 (SYS_VMSTAT, st, (int) global);
+}
+
+bool
+madvise (void *addr, size_t length, int advice)
+{
+  return syscall3 (SYS_MADVISE, addr, length, advice);
+}
@@ -3,6 +3,9 @@
 
 #include <stdbool.h>
 #include <debug.h>
+#include <madvise.h>
+#include <vmstat.h>
+#include <wsinfo.h>
 
 /* Process identifier. */
 typedef int pid_t;
@@ -45,4 +48,10 @@ bool readdir (int fd, char name[READDIR_MAX_LEN + 1]);
 bool isdir (int fd);
 int inumber (int fd);
 
+/* Extensions. */
+pid_t fork (void);
+bool wsinfo (struct wsinfo *);
+bool vmstat (struct vmstat *, bool global);
+bool madvise (void *addr, size_t length, int advice);
+
 #endif /* lib/user/syscall.h */
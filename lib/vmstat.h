@@ -0,0 +1,26 @@
+#ifndef __LIB_VMSTAT_H
+#define __LIB_VMSTAT_H
+
+/* Latency histogram buckets: bucket I counts operations that took
+   fewer than 2**(I + VMSTAT_HIST_SHIFT) CPU cycles, the last bucket
+   counts everything slower. */
+#define VMSTAT_HIST_BUCKETS 12
+#define VMSTAT_HIST_SHIFT 10
+
+/* Virtual memory counters, of one process or of the whole system, as
+   returned by the vmstat system call. */
+struct vmstat
+  {
+    long long minor_faults;     /* Pages brought in without I/O. */
+    long long major_faults;     /* Pages read from a file or swap. */
+    long long stack_faults;     /* Faults that grew the stack. */
+    long long evict_clean;      /* Evictions dropping a clean page. */
+    long long evict_dirty;      /* Evictions writing a page back. */
+    long long swap_ins;         /* Pages read back from swap. */
+    long long swap_outs;        /* Pages written to swap. */
+    long long pin_stalls;       /* Waits for a page still being written. */
+    long long swap_in_hist[VMSTAT_HIST_BUCKETS];
+    long long swap_out_hist[VMSTAT_HIST_BUCKETS];
+  };
+
+#endif /* lib/vmstat.h */
@@ -0,0 +1,16 @@
+#ifndef __LIB_WSINFO_H
+#define __LIB_WSINFO_H
+
+#include <stddef.h>
+
+/* Working set of a process, as returned by the wsinfo system call. */
+struct wsinfo
+  {
+    size_t ws_pages;            /* Pages referenced in the last interval. */
+    size_t resident_pages;      /* Frames held, shared frames included. */
+    size_t quota_pages;         /* Soft frame quota. */
+    int faults_per_sec;         /* Page-fault frequency. */
+    int suspended;              /* Nonzero while suspended by load control. */
+  };
+
+#endif /* lib/wsinfo.h */
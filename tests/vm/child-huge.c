@@ -0,0 +1,19 @@
+/* Child process of oom-commit.
+   Has a 64 MB BSS, more than RAM and swap together can back, so
+   exec is expected to refuse to load it. */
+
+#include "tests/lib.h"
+#include "tests/main.h"
+
+const char *test_name = "child-huge";
+
+#define SIZE (64 * 1024 * 1024)
+static char buf[SIZE];
+
+int
+main (void)
+{
+  buf[0] = 1;
+  buf[SIZE - 1] = 1;
+  return 0x42;
+}
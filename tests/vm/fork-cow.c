@@ -0,0 +1,41 @@
+/* Forks a child that reads, then overwrites, a large array shared
+   copy-on-write with its parent.  Each process must keep seeing
+   its own data. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (128 * 1024)
+
+static char buf[SIZE];
+
+void
+test_main (void)
+{
+  pid_t child;
+  size_t i;
+
+  memset (buf, 'p', SIZE);
+
+  child = fork ();
+  if (child == 0)
+    {
+      for (i = 0; i < SIZE; i++)
+        if (buf[i] != 'p')
+          fail ("child sees byte %zu as %d before writing", i, buf[i]);
+      memset (buf, 'c', SIZE);
+      for (i = 0; i < SIZE; i++)
+        if (buf[i] != 'c')
+          fail ("child sees byte %zu as %d after writing", i, buf[i]);
+      exit (81);
+    }
+  CHECK (child != PID_ERROR, "fork");
+  CHECK (wait (child) == 81, "wait for child");
+
+  for (i = 0; i < SIZE; i++)
+    if (buf[i] != 'p')
+      fail ("parent sees child's write at byte %zu", i);
+  msg ("parent's copy intact");
+}
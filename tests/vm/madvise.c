@@ -0,0 +1,33 @@
+/* Fills a BSS array, discards it with MADV_DONTNEED and checks it
+   reads back as zeros, then checks the other advice values are
+   accepted and a misaligned range is rejected. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGES 16
+#define SIZE (PAGES * 4096)
+
+static char buf[SIZE] __attribute__ ((aligned (4096)));
+
+void
+test_main (void)
+{
+  size_t i;
+
+  memset (buf, 0x5a, SIZE);
+  CHECK (madvise (buf, SIZE, MADV_DONTNEED), "madvise DONTNEED");
+  for (i = 0; i < SIZE; i++)
+    if (buf[i] != 0)
+      fail ("byte %zu is %d after DONTNEED", i, buf[i]);
+  msg ("discarded pages read as zeros");
+
+  CHECK (madvise (buf, SIZE, MADV_SEQUENTIAL), "madvise SEQUENTIAL");
+  CHECK (madvise (buf, SIZE, MADV_WILLNEED), "madvise WILLNEED");
+  CHECK (madvise (buf, SIZE, MADV_RANDOM), "madvise RANDOM");
+  CHECK (madvise (buf, SIZE, MADV_NORMAL), "madvise NORMAL");
+  CHECK (!madvise (buf + 1, SIZE - 1, MADV_DONTNEED),
+         "misaligned madvise fails");
+}
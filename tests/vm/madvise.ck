@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(madvise) begin
+(madvise) madvise DONTNEED
+(madvise) discarded pages read as zeros
+(madvise) madvise SEQUENTIAL
+(madvise) madvise WILLNEED
+(madvise) madvise RANDOM
+(madvise) madvise NORMAL
+(madvise) misaligned madvise fails
+(madvise) end
+EOF
+pass;
@@ -0,0 +1,17 @@
+/* Execs a child whose BSS cannot be backed by RAM plus swap, which
+   must fail cleanly, then runs a child that fits to check the kernel
+   carried on. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void)
+{
+  pid_t child;
+
+  CHECK (exec ("child-huge") == -1, "exec \"child-huge\" refused");
+  CHECK ((child = exec ("child-linear")) != -1, "exec \"child-linear\"");
+  CHECK (wait (child) == 0x42, "wait for child");
+}
@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(oom-commit) begin
+Load failed!
+(oom-commit) exec "child-huge" refused
+(oom-commit) exec "child-linear"
+(oom-commit) wait for child
+(oom-commit) end
+EOF
+pass;
@@ -0,0 +1,40 @@
+/* Runs child-linear several times in a row, so later runs start from
+   the pages recorded by the first, then rewrites the start of the
+   executable with its own bytes, which drops the record, and runs it
+   once more. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define RUN_CNT 3
+
+static char buf[4096];
+
+static void
+run_child (void)
+{
+  pid_t child;
+
+  CHECK ((child = exec ("child-linear")) != -1, "exec \"child-linear\"");
+  CHECK (wait (child) == 0x42, "wait for child");
+}
+
+void
+test_main (void)
+{
+  int handle;
+  int i;
+
+  for (i = 0; i < RUN_CNT; i++)
+    run_child ();
+
+  CHECK ((handle = open ("child-linear")) > 1, "open \"child-linear\"");
+  CHECK (read (handle, buf, sizeof buf) == sizeof buf, "read \"child-linear\"");
+  seek (handle, 0);
+  CHECK (write (handle, buf, sizeof buf) == sizeof buf,
+         "rewrite \"child-linear\"");
+  close (handle);
+
+  run_child ();
+}
@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(prepage-exec) begin
+(prepage-exec) exec "child-linear"
+(prepage-exec) wait for child
+(prepage-exec) exec "child-linear"
+(prepage-exec) wait for child
+(prepage-exec) exec "child-linear"
+(prepage-exec) wait for child
+(prepage-exec) open "child-linear"
+(prepage-exec) read "child-linear"
+(prepage-exec) rewrite "child-linear"
+(prepage-exec) exec "child-linear"
+(prepage-exec) wait for child
+(prepage-exec) end
+EOF
+pass;
@@ -0,0 +1,35 @@
+/* Writes every page of an untouched array, which faults each of them
+   in without I/O, then checks the process and system counters saw at
+   least that many minor faults. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGES 64
+#define SIZE (PAGES * 4096)
+
+static char buf[SIZE];
+
+void
+test_main (void)
+{
+  struct vmstat before, after, total;
+  size_t i;
+
+  CHECK (vmstat (&before, false), "vmstat");
+  for (i = 0; i < SIZE; i += 4096)
+    buf[i] = 1;
+  CHECK (vmstat (&after, false), "vmstat");
+  CHECK (vmstat (&total, true), "vmstat global");
+
+  if (after.minor_faults - before.minor_faults < PAGES)
+    fail ("%lld minor faults for %d new pages",
+          after.minor_faults - before.minor_faults, PAGES);
+  msg ("minor faults counted");
+
+  if (total.minor_faults < after.minor_faults
+      || total.major_faults < after.major_faults)
+    fail ("system counters below process counters");
+  msg ("system counters cover the process");
+}
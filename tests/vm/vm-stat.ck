@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(vm-stat) begin
+(vm-stat) vmstat
+(vm-stat) vmstat
+(vm-stat) vmstat global
+(vm-stat) minor faults counted
+(vm-stat) system counters cover the process
+(vm-stat) end
+EOF
+pass;
@@ -0,0 +1,38 @@
+/* Keeps touching an array until the working set sampler has seen
+   all of it, then checks the reported quota covers the working
+   set. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGES 32
+#define SIZE (PAGES * 4096)
+
+static char buf[SIZE];
+
+void
+test_main (void)
+{
+  struct wsinfo info;
+  int round;
+  size_t i;
+
+  CHECK (wsinfo (&info), "wsinfo");
+  for (round = 0; info.ws_pages < PAGES || info.resident_pages < PAGES;
+       round++)
+    {
+      if (round > 10000000)
+        fail ("working set never reached %d pages", PAGES);
+      for (i = 0; i < SIZE; i += 4096)
+        buf[i]++;
+      if (!wsinfo (&info))
+        fail ("wsinfo failed");
+    }
+  msg ("working set covers the array");
+
+  if (info.quota_pages < info.ws_pages)
+    fail ("quota %zu below working set %zu",
+          info.quota_pages, info.ws_pages);
+}
@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(ws-info) begin
+(ws-info) wsinfo
+(ws-info) working set covers the array
+(ws-info) end
+EOF
+pass;
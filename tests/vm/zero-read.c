@@ -0,0 +1,36 @@
+/* Reads a large BSS array that was never written, which maps every
+   page to the shared zero frame, then writes every other page and
+   checks the written pages got private copies and the others still
+   read as zeros. */
+
+#include <string.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGES 256
+#define SIZE (PAGES * 4096)
+
+static char buf[SIZE];
+
+void
+test_main (void)
+{
+  size_t i;
+
+  for (i = 0; i < SIZE; i++)
+    if (buf[i] != 0)
+      fail ("byte %zu of untouched array is %d", i, buf[i]);
+  msg ("untouched array reads as zeros");
+
+  for (i = 0; i < SIZE; i += 2 * 4096)
+    memset (buf + i, i / 4096 + 1, 4096);
+  msg ("wrote every other page");
+
+  for (i = 0; i < SIZE; i++)
+    {
+      char expected = (i / 4096) % 2 == 0 ? (char) (i / 4096 + 1) : 0;
+      if (buf[i] != expected)
+        fail ("byte %zu is %d, expected %d", i, buf[i], expected);
+    }
+  msg ("written pages are private, the rest still zero");
+}
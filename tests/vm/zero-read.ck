@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(zero-read) begin
+(zero-read) untouched array reads as zeros
+(zero-read) wrote every other page
+(zero-read) written pages are private, the rest still zero
+(zero-read) end
+EOF
+pass;
@@ -39,11 +39,27 @@
 #endif
 
 #include "vm/frame.h"
+#include "vm/page.h"
+#include "vm/oom.h"
+#include "vm/prepage.h"
+#include "vm/repl.h"
 #include "vm/swap.h"
+#include "vm/vmstat.h"
+#include "vm/ws.h"
+#include "vm/zswap.h"
 
 /* Page directory with kernel mappings only. */
 uint32_t *init_page_dir;
 
+/* True if 4 MB pages are enabled in CR4, see paging_init(). */
+bool pse_enabled;
+
+/* -nopse: Map the kernel with 4 kB pages only. */
+static bool pse_disabled;
+
+#define CPUID_PSE 0x00000008    /* CPUID.1:EDX, 4 MB pages supported. */
+#define CR4_PSE 0x00000010      /* Page Size Extensions. */
+
 #ifdef FILESYS
 /* -f: Format the file system? */
 static bool format_filesys;
@@ -62,6 +78,7 @@ static size_t user_page_limit = SIZE_MAX;
 
 static void bss_init (void);
 static void paging_init (void);
+static bool cpu_has_pse (void);
 
 static char **read_command_line (void);
 static char **parse_options (char **argv);
@@ -128,12 +145,21 @@ main (void)
   filesys_init (format_filesys);
 #endif
 
+  // Fault trace buffer, before the first user page fault
+  vmstat_init ();
+
   // Initialize frame table
   init_frame ();
 
   // Initialize swap table
   swap_init ();
 
+  // Start working set sampler
+  ws_init ();
+
+  // Recorded startup pages of executables
+  prepage_init ();
+
   printf ("Boot complete.\n");
 
   /* Run actions specified on kernel command line. */
@@ -168,6 +194,15 @@ paging_init (void)
   size_t page;
   extern char _start, _end_kernel_text;
 
+  /* Turn on 4 MB pages before any PDE uses them. */
+  pse_enabled = !pse_disabled && cpu_has_pse ();
+  if (pse_enabled)
+    {
+      uint32_t cr4;
+      asm volatile ("movl %%cr4, %0" : "=r" (cr4));
+      asm volatile ("movl %0, %%cr4" : : "r" (cr4 | CR4_PSE));
+    }
+
   pd = init_page_dir = palloc_get_page (PAL_ASSERT | PAL_ZERO);
   pt = NULL;
   for (page = 0; page < init_ram_pages; page++)
@@ -178,6 +213,18 @@ paging_init (void)
       size_t pte_idx = pt_no (vaddr);
       bool in_kernel_text = &_start <= vaddr && vaddr < &_end_kernel_text;
 
+      /* Each whole 4 MB of RAM is one TLB entry instead of 1,024.
+         A 4 MB span holding kernel text keeps its page table, so the
+         text stays read-only, and so does a partial last 4 MB. */
+      if (pse_enabled && pte_idx == 0
+          && init_ram_pages - page >= PTSPAN / PGSIZE
+          && !(vaddr < &_end_kernel_text && &_start < vaddr + PTSPAN))
+        {
+          pd[pde_idx] = pde_create_large (vaddr, true, false);
+          page += PTSPAN / PGSIZE - 1;
+          continue;
+        }
+
       if (pd[pde_idx] == 0)
         {
           pt = palloc_get_page (PAL_ASSERT | PAL_ZERO);
@@ -195,6 +242,17 @@ paging_init (void)
   asm volatile ("movl %0, %%cr3" : : "r" (vtop (init_page_dir)));
 }
 
+/* Returns true if the CPU supports 4 MB pages.  See [IA32-v2a]
+   "CPUID--CPU Identification". */
+static bool
+cpu_has_pse (void)
+{
+  uint32_t eax = 1, ebx, ecx, edx;
+
+  asm volatile ("cpuid" : "+a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx));
+  return (edx & CPUID_PSE) != 0;
+}
+
 /* Breaks the kernel command line into words and returns them as
    an argv-like array. */
 static char **
@@ -258,11 +316,40 @@ parse_options (char **argv)
       else if (!strcmp (name, "-swap"))
         swap_bdev_name = value;
 #endif
+#endif
+#ifdef VM
+      else if (!strcmp (name, "-fa"))
+        fault_around_pages = atoi (value);
+      else if (!strcmp (name, "-zswap"))
+        zswap_max_pages = atoi (value);
+      else if (!strcmp (name, "-lc"))
+        ws_load_control = true;
+      else if (!strcmp (name, "-lowat"))
+        pageout_low = atoi (value);
+      else if (!strcmp (name, "-hiwat"))
+        pageout_high = atoi (value);
+      else if (!strcmp (name, "-lp"))
+        mmap_large_pages = true;
+      else if (!strcmp (name, "-merge"))
+        merge_scan_pages = atoi (value);
+      else if (!strcmp (name, "-vmtrace"))
+        vmstat_trace_len = atoi (value);
+      else if (!strcmp (name, "-prepage"))
+        prepage_ms = atoi (value);
+      else if (!strcmp (name, "-overcommit"))
+        overcommit_pct = atoi (value);
+      else if (!strcmp (name, "-repl"))
+        {
+          if (!repl_select (value))
+            PANIC ("unknown replacement policy `%s' (use -h for help)", value);
+        }
 #endif
       else if (!strcmp (name, "-rs"))
         random_init (atoi (value));
       else if (!strcmp (name, "-mlfqs"))
         thread_mlfqs = true;
+      else if (!strcmp (name, "-nopse"))
+        pse_disabled = true;
 #ifdef USERPROG
       else if (!strcmp (name, "-ul"))
         user_page_limit = atoi (value);
@@ -386,8 +473,22 @@ usage (void)
 #endif
           "  -rs=SEED           Set random number seed to SEED.\n"
           "  -mlfqs             Use multi-level feedback queue scheduler.\n"
+          "  -nopse             Map kernel memory with 4 kB pages only.\n"
 #ifdef USERPROG
           "  -ul=COUNT          Limit user memory to COUNT pages.\n"
+#endif
+#ifdef VM
+          "  -fa=PAGES          Map up to PAGES executable pages per fault.\n"
+          "  -zswap=PAGES       Keep up to PAGES of compressed swap in RAM.\n"
+          "  -lc                Suspend processes while the system thrashes.\n"
+          "  -lowat=PAGES       Start background page-out below PAGES free.\n"
+          "  -hiwat=PAGES       Stop background page-out at PAGES free.\n"
+          "  -lp                Back aligned 4 MB of mmap with 4 MB pages.\n"
+          "  -merge=PAGES       Merge identical pages, hashing PAGES per batch.\n"
+          "  -vmtrace=N         Print the last N page faults at shutdown.\n"
+          "  -prepage=MS        Prefetch pages faulted in MS ms after exec.\n"
+          "  -overcommit=PCT    Commit up to PCT%% of RAM+swap, 0 for no limit.\n"
+          "  -repl=POLICY       Evict by clock (default), esc, 2q or arc.\n"
 #endif
           );
   shutdown_power_off ();
@@ -8,6 +8,7 @@
 #include <stdio.h>
 #include <string.h>
 #include "threads/loader.h"
+#include "threads/pte.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
 
@@ -39,6 +40,7 @@ static struct pool kernel_pool, user_pool;
 static void init_pool (struct pool *, void *base, size_t page_cnt,
                        const char *name);
 static bool page_from_pool (const struct pool *, void *page);
+static size_t scan_aligned (struct pool *, size_t page_cnt);
 
 /* Initializes the page allocator.  At most USER_PAGE_LIMIT
    pages are put into the user pool. */
@@ -66,7 +68,8 @@ palloc_init (size_t user_page_limit)
    otherwise from the kernel pool.  If PAL_ZERO is set in FLAGS,
    then the pages are filled with zeros.  If too few pages are
    available, returns a null pointer, unless PAL_ASSERT is set in
-   FLAGS, in which case the kernel panics. */
+   FLAGS, in which case the kernel panics.  If PAL_LARGE is set,
+   the first page is 4 MB aligned in physical memory. */
 void *
 palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
 {
@@ -78,7 +81,10 @@ palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
     return NULL;
 
   lock_acquire (&pool->lock);
-  page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
+  if (flags & PAL_LARGE)
+    page_idx = scan_aligned (pool, page_cnt);
+  else
+    page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
   lock_release (&pool->lock);
 
   if (page_idx != BITMAP_ERROR)
@@ -148,6 +154,22 @@ palloc_free_page (void *page)
   palloc_free_multiple (page, 1);
 }
 
+/* Returns the kernel virtual address of the first page in the
+   user pool.  User pages handed out by palloc_get_page() are
+   always at or above this address. */
+void *
+palloc_user_base (void)
+{
+  return user_pool.base;
+}
+
+/* Returns the number of pages in the user pool. */
+size_t
+palloc_user_page_cnt (void)
+{
+  return bitmap_size (user_pool.used_map);
+}
+
 /* Initializes pool P as starting at START and ending at END,
    naming it NAME for debugging purposes. */
 static void
@@ -180,3 +202,24 @@ page_from_pool (const struct pool *pool, void *page)
 
   return page_no >= start_page && page_no < end_page;
 }
+
+/* Finds PAGE_CNT free pages in POOL starting at a 4 MB aligned
+   physical address, marks them used and returns the index of the
+   first, or BITMAP_ERROR if there are none.  POOL's lock must be
+   held. */
+static size_t
+scan_aligned (struct pool *pool, size_t page_cnt)
+{
+  size_t pages_per_span = PTSPAN / PGSIZE;
+  size_t page_idx = (pages_per_span - pg_no (pool->base) % pages_per_span)
+                    % pages_per_span;
+  size_t pool_pages = bitmap_size (pool->used_map);
+
+  for (; page_idx + page_cnt <= pool_pages; page_idx += pages_per_span)
+    if (bitmap_none (pool->used_map, page_idx, page_cnt))
+      {
+        bitmap_set_multiple (pool->used_map, page_idx, page_cnt, true);
+        return page_idx;
+      }
+  return BITMAP_ERROR;
+}
@@ -66,6 +66,12 @@ static inline uintptr_t pd_no (const void *va) {
 #define PTE_U 0x4               /* 1=user/kernel, 0=kernel only. */
 #define PTE_A 0x20              /* 1=accessed, 0=not acccessed. */
 #define PTE_D 0x40              /* 1=dirty, 0=not dirty (PTEs only). */
+#define PTE_PS 0x80             /* 1=4 MB page, 0=page table (PDEs only). */
+#define PTE_LARGE_ADDR 0xffc00000 /* Address bits of a 4 MB page PDE. */
+
+/* A PDE with PTE_PS set maps a whole 4 MB page itself, and then D
+   is valid in it too.  Requires CR4.PSE, see [IA32-v3a] 3.7.3
+   "Mixing 4-KByte and 4-MByte Pages". */
 
 /* Returns a PDE that points to page table PT. */
 static inline uint32_t pde_create (uint32_t *pt) {
@@ -77,9 +83,28 @@ static inline uint32_t pde_create (uint32_t *pt) {
    PDE, which must "present", points to. */
 static inline uint32_t *pde_get_pt (uint32_t pde) {
   ASSERT (pde & PTE_P);
+  ASSERT (!(pde & PTE_PS));
   return ptov (pde & PTE_ADDR);
 }
 
+/* Returns a PDE that maps the 4 MB page starting at PAGE, which
+   must be 4 MB aligned in physical memory.
+   If WRITABLE is true then it will be writable as well.
+   If USER is true then user code may access it as well. */
+static inline uint32_t pde_create_large (void *page, bool writable,
+                                         bool user) {
+  ASSERT ((vtop (page) & ~PTE_LARGE_ADDR) == 0);
+  return vtop (page) | PTE_PS | PTE_P | (writable ? PTE_W : 0)
+         | (user ? PTE_U : 0);
+}
+
+/* Returns a pointer to the first page of the 4 MB page that PDE
+   maps. */
+static inline void *pde_get_large (uint32_t pde) {
+  ASSERT (pde & PTE_PS);
+  return ptov (pde & PTE_LARGE_ADDR);
+}
+
 /* Returns a PTE that points to PAGE.
    The PTE's page is readable.
    If WRITABLE is true then it will be writable as well.
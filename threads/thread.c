@@ -504,6 +504,13 @@ init_thread (struct thread *t, const char *name, int priority)
   
   t->num_fd = MIN_FD;
   list_init (&t->file_list);
+
+  t->num_mapid = 0;
+  list_init (&t->mmap_list);
+
+  t->frame_quota = SIZE_MAX;
+  t->vm_suspended = false;
+  sema_init (&t->vm_resume, 0);
   list_init (&t->children);
 
   t->elf = NULL;
@@ -4,6 +4,7 @@
 #include <debug.h>
 #include <list.h>
 #include <stdint.h>
+#include <vmstat.h>
 #include "threads/synch.h"
 #include "lib/kernel/hash.h"
 
@@ -117,6 +118,10 @@ struct thread
     int num_fd;
     struct list file_list;
 
+    // memory mapped file list
+    int num_mapid;
+    struct list mmap_list;
+
     // child list
     struct list children;
 
@@ -133,8 +138,55 @@ struct thread
 
     struct list *spt;
 
+    // address space regions, sorted by address, see vm/region.c
+    struct list regions;
+
     void *esp;
 
+    // next slot and slots left in this process's swap cluster
+    size_t swap_next;
+    size_t swap_left;
+
+    // working set estimate and page-fault frequency, see vm/ws.c
+    size_t ws_size;
+    size_t ws_resident;
+    size_t ws_acc;
+    size_t ws_resident_acc;
+    size_t ws_slack;
+    size_t frame_quota;
+    int fault_cnt;
+    int fault_rate;
+
+    // load control, set while the process is suspended for thrashing
+    bool vm_suspended;
+    struct semaphore vm_resume;
+
+    // fault, eviction and swap counters of this process, see vm/vmstat.c
+    struct vmstat vmstat;
+
+    // TLB invalidations deferred by pagedir_batch_begin(): nesting depth,
+    // pages invalidated and the range they span, see userprog/pagedir.c
+    int tlb_batch_depth;
+    int tlb_batch_cnt;
+    const uint8_t *tlb_batch_lo;
+    const uint8_t *tlb_batch_hi;
+
+    // startup window after exec, see vm/prepage.c: tick it closes at, 0
+    // once closed, page loads inside it and the set being recorded, NULL
+    // if the executable's pages were prefetched
+    int64_t prepage_until;
+    int prepage_loads;
+    struct prepage_set *prepage_set;
+
+    // anonymous pages committed to the process, its badness while
+    // `oom_kill` picks a victim, whether and at which tick it was picked,
+    // see vm/oom.c, and whether `process_exit` is tearing it down
+    size_t commit_cnt;
+    size_t oom_score;
+    bool oom_killed;
+    int64_t oom_kill_tick;
+    bool exiting;
+
     /* Owned by thread.c. */
     unsigned magic;                     /* Detects stack overflow. */
   };
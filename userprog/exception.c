@@ -7,7 +7,11 @@
 #include "threads/vaddr.h"
 
 #include "userprog/syscall.h"
+#include "vm/frame.h"
+#include "vm/oom.h"
 #include "vm/page.h"
+#include "vm/vmstat.h"
+#include "vm/ws.h"
 
 /* Number of page faults processed. */
 static long long page_fault_cnt;
@@ -146,12 +150,15 @@ page_fault (struct intr_frame *f)
 
   /* Count page faults. */
   page_fault_cnt++;
+  thread_current ()->fault_cnt++;
 
   /* Determine cause. */
   not_present = (f->error_code & PF_P) == 0;
   write = (f->error_code & PF_W) != 0;
   user = (f->error_code & PF_U) != 0;
 
+  vmstat_trace (fault_addr, write, user);
+
   // find page address from page fault address
   void* page = (void*) pg_round_down (fault_addr);
 
@@ -161,17 +168,35 @@ page_fault (struct intr_frame *f)
 
     exit(-1);
   }
-  else if (!not_present && write)
+
+  if (user)
+  {
+    // load control may have suspended the process, it holds no kernel
+    // locks on a fault from user mode
+    ws_wait_resume ();
+
+    // picked by the OOM killer, exit and free memory for the others
+    oom_check ();
+  }
+
+  if (!not_present && write)
   {
-    // tries to write to read-only page
+    // tries to write to read-only page, allowed only for a page shared
+    // copy-on-write after fork
+    struct spt_entry *cow = spt_find_vaddr (thread_current ()->spt, page);
+    if (cow == NULL || !cow->writable || !cow_fault (cow))
+    {
+      exit (-1);
+    }
 
-    exit (-1);
+    return;
   }
 
   // printf("Fault addr is %p, page fault at %p!\n", fault_addr, page);
 
-  // look up supplemental page table for v_addr
-  struct spt_entry* found = spt_find_vaddr (thread_current ()->spt, page);
+  // look up supplemental page table for v_addr, creating the entry if
+  // the page is in a region but untouched so far
+  struct spt_entry* found = spt_get_page (page);
 
   // find v_addr entry in supplemental page table
   if (found == NULL)
@@ -193,7 +218,7 @@ page_fault (struct intr_frame *f)
     }
     
 
-    if (!in_stack (esp, fault_addr))
+    if (!in_stack (esp, fault_addr, write))
     {
       // kill process, error out
 
@@ -229,6 +254,12 @@ page_fault (struct intr_frame *f)
     return;
     // PANIC ();
   }
+  else if (!write && frame_zero_map (found))
+  {
+    // read of an untouched zero-fill page, share the zero frame until
+    // the first write
+    return;
+  }
   else
   {
     // printf("allocate frame for %p\n", page);
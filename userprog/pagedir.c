@@ -11,6 +11,16 @@
 
 static uint32_t *active_pd (void);
 static void invalidate_pagedir (uint32_t *);
+static void invalidate_page (uint32_t *, const void *);
+static void flush_page (const void *);
+
+/* Most pages a batch of deferred invalidations flushes one at a
+   time with INVLPG.  Past this, one CR3 reload is cheaper. */
+#define TLB_FLUSH_CEILING 32
+
+/* TLB flushes: whole TLB by CR3 reload, and single pages. */
+static long long tlb_full_cnt;
+static long long tlb_page_cnt;
 
 /* Creates a new page directory that has mappings for kernel
    virtual addresses, but none for user virtual addresses.
@@ -40,7 +50,9 @@ pagedir_destroy (uint32_t *pd)
   for (pde = pd; pde < pd + pd_no (PHYS_BASE); pde++)
    
     
-    if (*pde & PTE_P)
+    if ((*pde & PTE_P) && (*pde & PTE_PS))
+      palloc_free_multiple (pde_get_large (*pde), PTSPAN / PGSIZE);
+    else if (*pde & PTE_P)
       {
         
         uint32_t *pt = pde_get_pt (*pde);
@@ -64,7 +76,10 @@ pagedir_destroy (uint32_t *pd)
    If PD does not have a page table for VADDR, behavior depends
    on CREATE.  If CREATE is true, then a new page table is
    created and a pointer into it is returned.  Otherwise, a null
-   pointer is returned. */
+   pointer is returned.
+   If VADDR lies in a 4 MB page, the PDE itself is returned,
+   since its P, W, U, A and D bits sit where a PTE's do.  A
+   cleared 4 MB PDE is replaced by a new page table on CREATE. */
 static uint32_t *
 lookup_page (uint32_t *pd, const void *vaddr, bool create)
 {
@@ -78,6 +93,11 @@ lookup_page (uint32_t *pd, const void *vaddr, bool create)
   /* Check for a page table for VADDR.
      If one is missing, create one if requested. */
   pde = pd + pd_no (vaddr);
+  if ((*pde & PTE_PS) && create && !(*pde & PTE_P))
+    *pde = 0;
+  else if (*pde & PTE_PS)
+    return pde;
+
   if (*pde == 0)
     {
       if (create)
@@ -142,16 +162,58 @@ pagedir_get_page (uint32_t *pd, const void *uaddr)
   ASSERT (is_user_vaddr (uaddr));
 
   pte = lookup_page (pd, uaddr, false);
-  if (pte != NULL && (*pte & PTE_P) != 0)
+  if (pte != NULL && (*pte & PTE_P) != 0 && (*pte & PTE_PS) != 0)
+    return ((uint8_t *) pde_get_large (*pte)
+            + ((uintptr_t) uaddr & ~PTE_LARGE_ADDR));
+  else if (pte != NULL && (*pte & PTE_P) != 0)
     return pte_get_page (*pte) + pg_ofs (uaddr);
   else
     return NULL;
 }
 
+/* Maps the 4 MB of user virtual memory at UPAGE in PD to the
+   physically contiguous frames starting at KPAGE with one 4 MB
+   page.  Both must be 4 MB aligned and the range must have no
+   mappings yet; an empty page table left there is freed.
+   If WRITABLE is true, the new page is read/write;
+   otherwise it is read-only.
+   Returns true if successful, false if 4 MB pages are not
+   enabled or part of the range is mapped. */
+bool
+pagedir_set_large (uint32_t *pd, void *upage, void *kpage, bool writable)
+{
+  uint32_t *pde = pd + pd_no (upage);
+
+  ASSERT (((uintptr_t) upage & ~PTE_LARGE_ADDR) == 0);
+  ASSERT (is_user_vaddr (upage));
+  ASSERT (pd != init_page_dir);
+
+  if (!pse_enabled)
+    return false;
+
+  if ((*pde & PTE_P) && (*pde & PTE_PS))
+    return false;
+  else if (*pde & PTE_P)
+    {
+      uint32_t *pt = pde_get_pt (*pde);
+      size_t i;
+
+      for (i = 0; i < PGSIZE / sizeof *pt; i++)
+        if (pt[i] & PTE_P)
+          return false;
+      palloc_free_page (pt);
+    }
+
+  *pde = pde_create_large (kpage, writable, true);
+  invalidate_pagedir (pd);
+  return true;
+}
+
 /* Marks user virtual page UPAGE "not present" in page
    directory PD.  Later accesses to the page will fault.  Other
    bits in the page table entry are preserved.
-   UPAGE need not be mapped. */
+   UPAGE need not be mapped.  In a 4 MB page, the whole 4 MB is
+   unmapped. */
 void
 pagedir_clear_page (uint32_t *pd, void *upage)
 {
@@ -164,7 +226,7 @@ pagedir_clear_page (uint32_t *pd, void *upage)
   if (pte != NULL && (*pte & PTE_P) != 0)
     {
       *pte &= ~PTE_P;
-      invalidate_pagedir (pd);
+      invalidate_page (pd, upage);
     }
 }
 
@@ -192,7 +254,7 @@ pagedir_set_dirty (uint32_t *pd, const void *vpage, bool dirty)
       else
         {
           *pte &= ~(uint32_t) PTE_D;
-          invalidate_pagedir (pd);
+          invalidate_page (pd, vpage);
         }
     }
 }
@@ -221,7 +283,7 @@ pagedir_set_accessed (uint32_t *pd, const void *vpage, bool accessed)
       else
         {
           *pte &= ~(uint32_t) PTE_A;
-          invalidate_pagedir (pd);
+          invalidate_page (pd, vpage);
         }
     }
 }
@@ -271,5 +333,85 @@ invalidate_pagedir (uint32_t *pd)
       /* Re-activating PD clears the TLB.  See [IA32-v3a] 3.12
          "Translation Lookaside Buffers (TLBs)". */
       pagedir_activate (pd);
+      tlb_full_cnt++;
+    }
+}
+
+/* Invalidates the TLB entry for user virtual page UPAGE if PD is
+   the active page directory.  Between pagedir_batch_begin() and
+   pagedir_batch_end() the invalidation is deferred: the current
+   thread only touches the affected pages through their kernel
+   addresses meanwhile, and a context switch in between reloads
+   CR3 anyway. */
+static void
+invalidate_page (uint32_t *pd, const void *upage)
+{
+  struct thread *t;
+
+  if (active_pd () != pd)
+    return;
+
+  t = thread_current ();
+  if (t->tlb_batch_depth > 0)
+    {
+      const uint8_t *page = pg_round_down (upage);
+      if (t->tlb_batch_cnt == 0 || page < t->tlb_batch_lo)
+        t->tlb_batch_lo = page;
+      if (t->tlb_batch_cnt == 0 || page + PGSIZE > t->tlb_batch_hi)
+        t->tlb_batch_hi = page + PGSIZE;
+      t->tlb_batch_cnt++;
+      return;
     }
+
+  flush_page (upage);
+}
+
+/* Drops the TLB entry for UPAGE in the active page directory.
+   In a 4 MB page, the entry for the whole 4 MB is dropped.
+   See [IA32-v2a] "INVLPG--Invalidate TLB Entry". */
+static void
+flush_page (const void *upage)
+{
+  asm volatile ("invlpg (%0)" : : "r" (upage) : "memory");
+  tlb_page_cnt++;
+}
+
+/* Starts deferring TLB invalidations for the active page
+   directory, for bulk updates such as munmap or process exit.
+   Batches nest; the outermost pagedir_batch_end() flushes. */
+void
+pagedir_batch_begin (void)
+{
+  thread_current ()->tlb_batch_depth++;
+}
+
+/* Ends a batch started by pagedir_batch_begin().  The pages
+   invalidated meanwhile are flushed one by one if they span at
+   most TLB_FLUSH_CEILING pages, otherwise the whole TLB is. */
+void
+pagedir_batch_end (void)
+{
+  struct thread *t = thread_current ();
+  const uint8_t *page;
+
+  ASSERT (t->tlb_batch_depth > 0);
+
+  if (--t->tlb_batch_depth > 0 || t->tlb_batch_cnt == 0)
+    return;
+
+  if ((size_t) (t->tlb_batch_hi - t->tlb_batch_lo) / PGSIZE
+      <= TLB_FLUSH_CEILING)
+    for (page = t->tlb_batch_lo; page < t->tlb_batch_hi; page += PGSIZE)
+      flush_page (page);
+  else
+    invalidate_pagedir (active_pd ());
+  t->tlb_batch_cnt = 0;
+}
+
+/* Prints TLB flush statistics. */
+void
+pagedir_print_stats (void)
+{
+  printf ("TLB: %lld full flushes, %lld single-page flushes\n",
+          tlb_full_cnt, tlb_page_cnt);
 }
@@ -28,8 +28,11 @@
 #include "lib/log.h"
 #include "vm/frame.h"
 #include "vm/page.h"
+#include "vm/prepage.h"
+#include "vm/region.h"
 
 static thread_func start_process NO_RETURN;
+static thread_func start_fork NO_RETURN;
 static bool load (const char *cmdline, void (**eip) (void), void **esp);
 
 struct thread_node* find_child (tid_t tid, struct thread *cur_thread);
@@ -130,6 +133,9 @@ start_process (void *cli_input_)
     parent->child_load = LOADED;
   }
 
+  // bring in the pages the last run of this binary started with
+  prepage_exec ();
+
   /* Start the user process by simulating a return from an
      interrupt, implemented by intr_exit (in
      threads/intr-stubs.S).  Because intr_exit takes all of its
@@ -140,6 +146,88 @@ start_process (void *cli_input_)
   NOT_REACHED ();
 }
 
+/* Starts a child process that is a copy of the current one, resuming
+   from the system call frame F with fork() returning 0 in the child.
+   Returns the child's thread id, or TID_ERROR if the child could not
+   be created. */
+tid_t
+process_fork (struct intr_frame *f)
+{
+  struct thread *cur = thread_current ();
+  tid_t tid;
+
+  // child copies the frame before the parent returns from the syscall
+  struct intr_frame *if_ = malloc (sizeof *if_);
+  if (if_ == NULL)
+    return TID_ERROR;
+  memcpy (if_, f, sizeof *if_);
+
+  tid = thread_create (cur->name, PRI_DEFAULT, start_fork, if_);
+  if (tid == TID_ERROR)
+  {
+    free (if_);
+  }
+  else
+  {
+    strlcpy(cur->elf_name, cur->name, 16);
+
+    sema_down (&cur->sema_load);
+    if (!cur->child_load)
+    {
+      tid = TID_ERROR;
+    }
+  }
+
+  return tid;
+}
+
+/* A thread function that duplicates the parent's address space and
+   open files, then returns to user mode where the parent called
+   fork(). */
+static void
+start_fork (void *if__)
+{
+  struct intr_frame if_;
+  bool success = false;
+
+  memcpy (&if_, if__, sizeof if_);
+  free (if__);
+
+  struct thread *child = thread_current ();
+  struct thread *parent = child->parent;
+
+  // parent stays blocked in process_fork until we are done with it
+  child->spt = spt_init ();
+  child->pagedir = pagedir_create ();
+  if (child->pagedir != NULL)
+  {
+    process_activate ();
+
+    child->elf = file_reopen (parent->elf);
+    if (child->elf != NULL)
+    {
+      file_deny_write (child->elf);
+      success = spt_fork (parent, child->elf)
+                && copy_file_nodes (parent) && copy_mmap_nodes (parent);
+    }
+  }
+
+  parent->child_load = success;
+  sema_up (&parent->sema_load);
+
+  if (!success)
+  {
+    child->exit_stat = LOAD_FAIL;
+    thread_exit ();
+  }
+
+  // fork() returns 0 in the child
+  if_.eax = 0;
+
+  asm volatile ("movl %0, %%esp; jmp intr_exit" : : "g" (&if_) : "memory");
+  NOT_REACHED ();
+}
+
 /* Waits for thread TID to die and returns its exit status.  If
    it was terminated by the kernel (i.e. killed due to an
    exception), returns -1.  If TID is invalid or if it was not a
@@ -201,15 +289,19 @@ process_exit (void)
 
   struct thread *cur = thread_current ();
 
-  // solve rox cases
-  if (cur->elf != NULL)
+  // the OOM killer no longer picks or waits for this process
+  cur->exiting = true;
+
+  // memory is given back before waiting for the parent below, so a
+  // parent that is slow to wait, or never does, holds up no frames,
+  // swap slots or dirty mapped pages
+
+  // write back dirty mapped pages while the pages are still mapped
+  if (!list_empty (&cur->mmap_list))
   {
-    file_allow_write(cur->elf);
-    file_close(cur->elf);
+    remove_all_mmap_node (&cur->mmap_list);
   }
 
-  reap ();
-
   if (!list_empty (&cur->file_list))
   {
     remove_all_file_node (&cur->file_list);
@@ -231,6 +323,28 @@ process_exit (void)
   //   printf("v.addr: %p, p.addr: %p, swap ind.: %d\n", k->v_addr, k->p_addr, k->swap_index);
   // }
 
+  // publish the startup pages of a process that exits inside its window
+  prepage_exit ();
+
+  // give back frames and swap slots before the page directory goes
+  // away, so the global clock never walks a dead process's page table
+  if (cur->spt != NULL)
+  {
+    spt_destroy ();
+  }
+
+  // solve rox cases, executable stays open until its shared text frames
+  // are dropped, so the cache never holds a closed inode
+  if (cur->elf != NULL)
+  {
+    file_allow_write(cur->elf);
+    file_close(cur->elf);
+    cur->elf = NULL;
+  }
+
+  // only the exit status handshake waits for the parent
+  reap ();
+
   /* Destroy the current process's page directory and switch back
      to the kernel-only page directory. */
   pd = cur->pagedir;
@@ -245,8 +359,10 @@ process_exit (void)
          that's been freed (and cleared). */
       cur->pagedir = NULL;
       pagedir_activate (NULL);
-      // pagedir_destroy (pd);
-      // printf("page_destroy succeeded\n");
+
+      // frees the page tables, and the initial stack page if it is
+      // still mapped, which never was in the frame table
+      pagedir_destroy (pd);
     }
 
   // printf("done\n");
@@ -584,62 +700,14 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
   ASSERT (pg_ofs (upage) == 0);
   ASSERT (ofs % PGSIZE == 0);
 
-  // printf("Load segment called!\n");
-
-  file_seek (file, ofs);
-  while (read_bytes > 0 || zero_bytes > 0)
-    {
-      // printf("Create spt entry for %p!\n", upage);
-      /* Calculate how to fill this page.
-         We will read PAGE_READ_BYTES bytes from FILE
-         and zero the final PAGE_ZERO_BYTES bytes. */
-      size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
-      size_t page_zero_bytes = PGSIZE - page_read_bytes;
-
-      // Load virtual address to supplemental page table
-      struct list *spt = thread_current()->spt;
-      if(!create_spt_entry (spt, file, ofs, upage, page_read_bytes,
-                            page_zero_bytes, writable, false))
-      {
-        // load failed
-        printf("Load failed!\n");
-
-        return false;
-      }
-      else
-      {
-        // Advance offset for files that require multiple pages
-        ofs += PGSIZE;
-      }
-      
-
-      // Uncomment to load directly to physical memory
-      // /* Get a page of memory. */
-      // uint8_t *kpage = palloc_get_page (PAL_USER);
-      // if (kpage == NULL)
-      //   return false;
-
-      // /* Load this page. */
-      // if (file_read (file, kpage, page_read_bytes) != (int) page_read_bytes)
-      //   {
-      //     palloc_free_page (kpage);
-      //     return false;
-      //   }
-      // memset (kpage + page_read_bytes, 0, page_zero_bytes);
-
-      // /* Add the page to the process's address space. */
-      // if (!install_page (upage, kpage, writable))
-      //   {
-      //     palloc_free_page (kpage);
-      //     return false;
-      //   }
-
-      /* Advance. */
-      read_bytes -= page_read_bytes;
-      zero_bytes -= page_zero_bytes;
-      upage += PGSIZE;
-    }
-    // printf("Load completed!\n");
+  // one region covers the segment, its pages get entries on first touch
+  if (!region_add (upage, (read_bytes + zero_bytes) / PGSIZE, file, ofs,
+                   read_bytes, writable,
+                   writable ? REGION_DATA : REGION_CODE))
+  {
+    printf("Load failed!\n");
+    return false;
+  }
 
   return true;
 }
@@ -3,6 +3,8 @@
 
 #include "threads/thread.h"
 
+struct intr_frame;
+
 struct thread_node
 {
   tid_t tid;
@@ -13,6 +15,7 @@ struct thread_node
 };
 
 tid_t process_execute (const char *file_name);
+tid_t process_fork (struct intr_frame *f);
 int process_wait (tid_t);
 void process_exit (void);
 void process_activate (void);
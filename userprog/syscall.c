@@ -4,6 +4,8 @@
 #include "userprog/pagedir.h"
 #include "userprog/process.h"
 #include <stdio.h>
+#include <round.h>
+#include <string.h>
 #include "devices/input.h"
 #include "devices/shutdown.h"
 #include "threads/interrupt.h"
@@ -11,23 +13,29 @@
 #include "threads/synch.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
+#include "vm/oom.h"
+#include "vm/page.h"
+#include "vm/region.h"
+#include "vm/vmstat.h"
 #include "lib/kernel/stdio.h"
 #include "lib/stdio.h"
 #include <syscall-nr.h>
+#include <wsinfo.h>
 #include "userprog/syscall.h"
 
 #define CODE_SEG 0x08048000
 
+// Largest part of a read or write buffer pinned at once
+#define PIN_CHUNK (16 * PGSIZE)
+
 typedef struct file file;
 struct lock filesys_lock;
 
-static int get_user (const uint8_t *uaddr);
-static bool put_user (uint8_t *udst, uint8_t byte);
 static void syscall_handler (struct intr_frame *f);
 
 void check_ptr (const void *vaddr);
-void check_read_ptr (const void *ptr);
-void check_buffer(void* buffer, unsigned size);
+void pin_buffer (const void *buffer, unsigned size, bool write);
+unsigned pin_string (const char *str);
 
 int add_file_node(file *file);
 void close_file (int fd);
@@ -35,6 +43,12 @@ struct file_node *find_file_node (int fd);
 void remove_file_node (int fd);
 void remove_all_file_node (struct list *list_ptr);
 
+struct mmap_node *find_mmap_node (int mapid);
+void unmap_mmap_node (struct mmap_node *node);
+void remove_all_mmap_node (struct list *list_ptr);
+bool copy_file_nodes (struct thread *parent);
+bool copy_mmap_nodes (struct thread *parent);
+
 int write (int fd, void *buffer, uint32_t size);
 void exit (int status);
 int sys_read (int fd, void *buffer, unsigned size);
@@ -49,6 +63,11 @@ bool remove (const char *file);
 void seek (int fd, unsigned position);
 unsigned tell (int fd);
 int sys_wait(tid_t pid);
+int sys_mmap (int fd, void *addr);
+bool sys_wsinfo (struct wsinfo *info);
+bool sys_vmstat (struct vmstat *st, bool global);
+bool sys_madvise (void *addr, size_t length, int advice);
+void sys_munmap (int mapid);
 
 void syscall_init (void)
 {
@@ -66,6 +85,9 @@ static void syscall_handler (struct intr_frame * f){
   struct thread *cur = thread_current ();
   cur->esp = f->esp;
 
+  // picked by the OOM killer, exit and free memory for the others
+  oom_check ();
+
   check_ptr(f->esp);
   check_ptr(f->esp+FD);
   check_ptr(f->esp+BUF);
@@ -156,85 +178,43 @@ static void syscall_handler (struct intr_frame * f){
       f->eax = filesize((int)*((uint32_t *)(f->esp + FD)));
       break;
 
-    default:
-      exit(-1);
+    case SYS_FORK:
+      f->eax = process_fork(f);
       break;
-  }
-}
-
-/* Reads a byte at user virtual address UADDR.
-   UADDR must be below PHYS_BASE (in kernel virtual memory).
-   Returns the byte value if successful, -1 if a segfault
-   occurred. */
-static int
-get_user (const uint8_t *uaddr)
-{
-  int result;
-
-  if ((uint32_t)uaddr >= (uint32_t)CODE_SEG)
-  {
-    // above PHYS_BASE, seg fault
-    return -1;
-  }
-  else
-  {
-    asm ("movl $1f, %0; movzbl %1, %0; 1:"
-        : "=&a" (result) : "m" (*uaddr));
 
-    return result;
-  }
-}
-
-/* Writes BYTE to user address UDST.
-   UDST must be below PHYS_BASE (in user virtual memory).
-   Returns true if successful, false if a segfault occurred. */
-static bool
-put_user (uint8_t *udst, uint8_t byte)
-{
-  int error_code;
+    case SYS_MMAP:
+      check_ptr(f->esp+FD);
+      check_ptr(f->esp+BUF);
+      f->eax = sys_mmap((int)*((uint32_t *)(f->esp + FD)), (void*)*((uint32_t *)(f->esp + BUF)));
+      break;
 
-  if ((uint32_t)udst >= (uint32_t)CODE_SEG)
-  {
-    // below PHYS_BASE, seg fault
-    return false;
-  }
-  else
-  {
-    asm ("movl $1f, %0; movb %b2, %1; 1:"
-        : "=&a" (error_code), "=m" (*udst) : "q" (byte));
-    return error_code != -1;
-  }
-}
+    case SYS_MUNMAP:
+      check_ptr(f->esp+FD);
+      sys_munmap((int)*((uint32_t *)(f->esp + FD)));
+      break;
 
-void check_read_ptr (const void *ptr){
+    case SYS_WSINFO:
+      check_ptr(f->esp+FD);
+      f->eax = sys_wsinfo((struct wsinfo *)*((uint32_t *)(f->esp + FD)));
+      break;
 
-  if (!is_user_vaddr(ptr) || (uint32_t)ptr < (uint32_t) CODE_SEG)
-  {
-    exit(-1);
-  }
-  // if (!pagedir_get_page(thread_current()->pagedir, ptr))
-  // {
-  //   exit(-1);
-  // }
-  if (ptr == NULL)
-  {
-    exit(-1);
-  }
+    case SYS_VMSTAT:
+      check_ptr(f->esp+FD);
+      check_ptr(f->esp+BUF);
+      f->eax = sys_vmstat((struct vmstat *)*((uint32_t *)(f->esp + FD)), (bool)*((uint32_t *)(f->esp + BUF)));
+      break;
 
-  return;
-}
+    case SYS_MADVISE:
+      check_ptr(f->esp+FD);
+      check_ptr(f->esp+BUF);
+      check_ptr(f->esp+SIZE);
+      f->eax = sys_madvise((void *)*((uint32_t *)(f->esp + FD)), (size_t)*((uint32_t *)(f->esp + BUF)), (int)*((uint32_t *)(f->esp + SIZE)));
+      break;
 
-void
-check_read_buffer(void* buffer, unsigned size){
-  unsigned num;
-  char* iter = (char *) buffer;
-  for(num = 0; num < size; num++){
-    check_read_ptr((const void*)iter);
-    iter++;
-    // printf("Check ptr %p\n", iter);
+    default:
+      exit(-1);
+      break;
   }
-
-  return;
 }
 
 void check_ptr (const void *ptr){
@@ -255,17 +235,62 @@ void check_ptr (const void *ptr){
   return;
 }
 
+/**
+ * Purpose:
+ *  Pins a user buffer for the rest of a syscall, kills the process if
+ *  any of it is invalid
+ *
+ * Args:
+ *  buffer {void*} User buffer
+ *  size {unsigned} Buffer length in bytes
+ *  write    {bool} True if the kernel writes to the buffer
+ *
+ * Returns:
+ *  None
+ */
 void
-check_buffer(void* buffer, unsigned size){
-  unsigned num;
-  char* iter = (char *) buffer;
-  for(num = 0; num < size; num++){
-    check_ptr((const void*)iter);
-    iter++;
-    // printf("Check ptr %p\n", iter);
+pin_buffer (const void *buffer, unsigned size, bool write)
+{
+  if ((uint32_t) buffer < (uint32_t) CODE_SEG
+      || !page_pin_range (buffer, size, write))
+  {
+    exit (-1);
   }
+}
 
-  return;
+/**
+ * Purpose:
+ *  Pins a user string for the rest of a syscall a page at a time, kills
+ *  the process if it runs into an invalid page before its terminator
+ *
+ * Args:
+ *  str {char*} User string
+ *
+ * Returns:
+ *  {unsigned} String length, the pinned range is one byte longer
+ */
+unsigned
+pin_string (const char *str)
+{
+  const char *iter = str;
+
+  for (;;)
+  {
+    unsigned left = PGSIZE - pg_ofs (iter);
+    if ((uint32_t) str < (uint32_t) CODE_SEG
+        || !page_pin_range (iter, left, false))
+    {
+      page_unpin_range (str, iter - str);
+      exit (-1);
+    }
+
+    const char *end = memchr (iter, '\0', left);
+    if (end != NULL)
+    {
+      return end - str;
+    }
+    iter += left;
+  }
 }
 
 int
@@ -353,52 +378,208 @@ remove_all_file_node (struct list *list_ptr)
   }
 }
 
+// find mapping in mmap list by mapid
+struct mmap_node *
+find_mmap_node (int mapid)
+{
+  struct list *mmap_list = &thread_current ()->mmap_list;
 
-/*                   Syscalls Implemented Below                       */
+  struct list_elem *e;
+  for (e = list_begin (mmap_list); e != list_end (mmap_list); e = list_next (e))
+  {
+    struct mmap_node *m = list_entry (e, struct mmap_node, elem);
+    if(m->mapid == mapid)
+    {
+      return m;
+    }
+  }
+  return NULL;
+}
 
-int write (int fd, void* buffer, uint32_t size) {
-  check_buffer(buffer, size);
-  const int MAX_BUF = 100;
-  int size_cpy;
+// unmaps every page of a mapping, dirty pages are written back to the file;
+// only pages touched since the mapping was made have an entry to remove
+void
+unmap_mmap_node (struct mmap_node *node)
+{
+  struct thread *cur = thread_current ();
+  uint8_t *end = (uint8_t *) node->addr + node->page_cnt * PGSIZE;
+
+  pagedir_batch_begin ();
+  struct list_elem *e = list_begin (cur->spt);
+  while (e != list_end (cur->spt))
+  {
+    struct spt_entry *spte = list_entry (e, struct spt_entry, elem);
+    e = list_next (e);
+
+    if ((uint8_t *) spte->v_addr >= (uint8_t *) node->addr
+        && (uint8_t *) spte->v_addr < end)
+    {
+      spt_remove_page (spte);
+    }
+  }
+  pagedir_batch_end ();
+  region_unmap (node->addr, node->page_cnt);
 
-  put_user(buffer, size);
+  file_close (node->file);
+  list_remove (&node->elem);
+  free (node);
+}
+
+//needs to unmap all files on exit from process!
+void
+remove_all_mmap_node (struct list *list_ptr)
+{
+  while (!list_empty (list_ptr))
+  {
+    unmap_mmap_node (list_entry (list_front (list_ptr), struct mmap_node, elem));
+  }
+}
+
+// gives a forked child its own handle on each of the parent's open
+// files, under the same fd and at the same position
+bool
+copy_file_nodes (struct thread *parent)
+{
+  struct thread *cur = thread_current ();
+  struct list_elem *e;
+  bool success = true;
 
   lock_acquire (&filesys_lock);
-  if (fd == 1)
-  { 
-    size_cpy = size;
-    while(size_cpy > MAX_BUF)
+
+  for (e = list_rbegin (&parent->file_list); e != list_rend (&parent->file_list);
+       e = list_prev (e))
+  {
+    struct file_node *f = list_entry (e, struct file_node, elem);
+    struct file_node *node = malloc (sizeof (struct file_node));
+    struct file *file = file_reopen (f->file);
+    if (node == NULL || file == NULL)
     {
-      putbuf(buffer, MAX_BUF);
-      if(size_cpy > MAX_BUF){
-        size_cpy -= MAX_BUF;
-      }
+      free (node);
+      file_close (file);
+      success = false;
+      break;
+    }
+
+    file_seek (file, file_tell (f->file));
+    node->fd = f->fd;
+    node->file = file;
+    list_push_front (&cur->file_list, &node->elem);
+  }
+  cur->num_fd = parent->num_fd;
+
+  lock_release (&filesys_lock);
+
+  return success;
+}
+
+// maps each of the parent's mapped files again in a forked child; the
+// parent's dirty pages are written back first, so both see the same data
+bool
+copy_mmap_nodes (struct thread *parent)
+{
+  struct thread *cur = thread_current ();
+  struct list_elem *e;
+
+  for (e = list_begin (&parent->mmap_list); e != list_end (&parent->mmap_list);
+       e = list_next (e))
+  {
+    struct mmap_node *m = list_entry (e, struct mmap_node, elem);
+    struct mmap_node *node = malloc (sizeof (struct mmap_node));
+    if (node == NULL)
+    {
+      return false;
     }
-    putbuf(buffer, size_cpy);
+
+    lock_acquire (&filesys_lock);
+    node->file = file_reopen (m->file);
     lock_release (&filesys_lock);
+    if (node->file == NULL)
+    {
+      free (node);
+      return false;
+    }
+
+    node->mapid = m->mapid;
+    node->addr = m->addr;
+    node->page_cnt = 0;
+    list_push_back (&cur->mmap_list, &node->elem);
 
-    return size;
+    // pages the parent never touched are still clean in the file
+    uint8_t *end = (uint8_t *) m->addr + m->page_cnt * PGSIZE;
+    struct list_elem *pe;
+    for (pe = list_begin (parent->spt); pe != list_end (parent->spt);
+         pe = list_next (pe))
+    {
+      struct spt_entry *p = list_entry (pe, struct spt_entry, elem);
+      if ((uint8_t *) p->v_addr >= (uint8_t *) m->addr
+          && (uint8_t *) p->v_addr < end)
+      {
+        spt_writeback_page (p);
+      }
+    }
+
+    if (!region_fork_mmap (parent, m->addr, m->page_cnt, node->file))
+    {
+      return false;
+    }
+    node->page_cnt = m->page_cnt;
   }
+  cur->num_mapid = parent->num_mapid;
+
+  return true;
+}
+
+
+/*                   Syscalls Implemented Below                       */
+
+int write (int fd, void* buffer, uint32_t size) {
+  uint8_t *buf = buffer;
+  uint32_t done = 0;
+  file *cur_file = NULL;
+
   if (fd == 0 ||fd == 2){
-    lock_release (&filesys_lock);
     return 0;
   }
-  int status = 0;
-
-  struct file_node *node = find_file_node(fd);
-  if(node == NULL)
+  if (fd != 1)
   {
+    lock_acquire (&filesys_lock);
+    struct file_node *node = find_file_node(fd);
     lock_release (&filesys_lock);
-
-    return -1;
+    if(node == NULL)
+    {
+      return -1;
+    }
+    cur_file = node->file;
   }
 
-  file *cur_file = node->file; 
-  status = file_write (cur_file, buffer, size);
+  // one chunk pinned at a time, a large buffer never holds down more
+  // than PIN_CHUNK bytes of frames
+  while (done < size)
+  {
+    uint32_t chunk = size - done < PIN_CHUNK ? size - done : PIN_CHUNK;
+    int status = chunk;
 
-  lock_release (&filesys_lock);
+    pin_buffer (buf + done, chunk, false);
+    lock_acquire (&filesys_lock);
+    if (cur_file == NULL)
+    {
+      putbuf ((const char *) buf + done, chunk);
+    }
+    else
+    {
+      status = file_write (cur_file, buf + done, chunk);
+    }
+    lock_release (&filesys_lock);
+    page_unpin_range (buf + done, chunk);
 
-  return status;
+    done += status;
+    if (status < (int) chunk)
+    {
+      break;
+    }
+  }
+
+  return done;
 }
 
 void exit (int status){
@@ -410,14 +591,11 @@ void exit (int status){
 }
 
 tid_t exec (const char * cmd_line){
-  char * iter = cmd_line;
-  check_ptr(iter);
-  while(*iter != '\0'){
-    check_ptr(iter);
-    iter++;
-  }
+  unsigned len = pin_string (cmd_line);
+  tid_t tid = process_execute(cmd_line);
+  page_unpin_range (cmd_line, len + 1);
 
-  return process_execute(cmd_line);
+  return tid;
 }
 
 void halt(void) {
@@ -448,50 +626,33 @@ int filesize(int fd) {
 }
 
 bool create(const char *file, unsigned initial_size) {
-  char * iter = file;
-  check_ptr(iter);
-  while(*iter != '\0'){
-    check_ptr(iter);
-    iter++;
-  }
-  const int INVALID = -1;
-  if(file == NULL){
-    exit(INVALID);
-  }
+  unsigned len = pin_string (file);
 
   lock_acquire(&filesys_lock);
   bool ret = filesys_create(file, initial_size);
   lock_release(&filesys_lock);
+
+  page_unpin_range (file, len + 1);
   return ret; 
 } 
 
  int sys_open(const char *file) {
   // printf("file ptr: %p\n", file);
 
-  check_ptr(file);
+  unsigned len = pin_string (file);
   const int INVALID = -1;
   lock_acquire(&filesys_lock);
 
-  if (file == NULL)
-  {
-    lock_release(&filesys_lock);
-    // printf("file ptr is null\n");
-    return INVALID;
-  }
-
-  // printf("file ptr: %p\n", file);
-
   struct file* opened = filesys_open (file);
-  if (opened == NULL)
+  int ret = INVALID;
+  if (opened != NULL)
   {
-    lock_release(&filesys_lock);
-    // printf("filesys_open returned a null ptr\n");
-    return INVALID;
+    ret = add_file_node(opened);
   }
-  int ret = add_file_node(opened);
 
   // printf("sys open returns %d\n", ret);
   lock_release(&filesys_lock);
+  page_unpin_range (file, len + 1);
 
   return ret;
 }
@@ -533,64 +694,68 @@ unsigned tell(int fd) {
 }
 
 bool remove(const char *file) {
-  char * iter = file;
-  check_ptr(iter);
-  while(*iter != '\0'){
-    check_ptr(iter);
-    iter++;
-  }
+  unsigned len = pin_string (file);
+
   lock_acquire(&filesys_lock);
   bool ret = filesys_remove(file);
   lock_release(&filesys_lock);
+
+  page_unpin_range (file, len + 1);
   return ret;
 }
 
 
 int sys_read (int fd, void *buffer, unsigned size) {
-  // printf("Reading now!\n");
-  check_read_buffer(buffer, size);
-  get_user(buffer);
-  lock_acquire(&filesys_lock);
-  if (fd == 0){
-
-    uint8_t* buf = (uint8_t *) buffer;
-    uint32_t i;
-    for (i = 0; i < size; i++)
-	  {
-	    buf[i] = input_getc();
-	  }
-    buffer = buf;
+  uint8_t *buf = buffer;
+  unsigned done = 0;
+  file *cur_file = NULL;
 
-    // printf("fd 0, size = %d\n", size);
-    lock_release(&filesys_lock);
-    return size;
-  }
   if (fd == 1){
-    // printf("fd 1, read failed\n");
-    lock_release(&filesys_lock);
     return -1;
   }
-
-  int read_len = 0;
-
-  struct file_node *node = find_file_node(fd);
-  if(node == NULL)
+  if (fd != 0)
   {
+    lock_acquire(&filesys_lock);
+    struct file_node *node = find_file_node(fd);
     lock_release(&filesys_lock);
-    // printf("File node find failed!\n");
-    return -1;
+    if(node == NULL)
+    {
+      return -1;
+    }
+    cur_file = node->file;
   }
 
-  
-
-  file *cur_file = node->file; 
-  if (cur_file != NULL)
+  // one chunk pinned at a time, like `write`
+  while (done < size)
   {
-    read_len = file_read(cur_file,buffer, size);
+    unsigned chunk = size - done < PIN_CHUNK ? size - done : PIN_CHUNK;
+    int read_len = chunk;
+    unsigned i;
+
+    pin_buffer (buf + done, chunk, true);
+    lock_acquire(&filesys_lock);
+    if (cur_file == NULL)
+    {
+      for (i = 0; i < chunk; i++)
+      {
+        buf[done + i] = input_getc();
+      }
+    }
+    else
+    {
+      read_len = file_read(cur_file, buf + done, chunk);
+    }
+    lock_release(&filesys_lock);
+    page_unpin_range (buf + done, chunk);
+
+    done += read_len;
+    if (read_len < (int) chunk)
+    {
+      break;
+    }
   }
-  lock_release(&filesys_lock);
-  // printf("read success, len = %d\n", read_len);
-  return read_len;
+
+  return done;
 }
 
 void close(int fd) {
@@ -608,3 +773,147 @@ void close(int fd) {
   lock_release(&filesys_lock);
   return;
 }
+
+int sys_mmap (int fd, void *addr) {
+  const int MAP_FAILED = -1;
+  struct thread *cur = thread_current ();
+
+  if (addr == NULL || pg_ofs (addr) != 0)
+    return MAP_FAILED;
+
+  lock_acquire(&filesys_lock);
+
+  struct file_node *node = find_file_node(fd);
+  if(node == NULL)
+  {
+    lock_release(&filesys_lock);
+    return MAP_FAILED;
+  }
+
+  // mapping keeps its own handle, so it outlives a close of fd
+  struct file *file = file_reopen (node->file);
+  off_t length = file != NULL ? file_length (file) : 0;
+
+  lock_release(&filesys_lock);
+
+  if (length == 0)
+  {
+    file_close (file);
+    return MAP_FAILED;
+  }
+
+  // every page of the mapping must be unused user address space
+  size_t page_cnt = DIV_ROUND_UP (length, PGSIZE);
+  size_t i;
+  if (region_overlaps (addr, page_cnt))
+  {
+    file_close (file);
+    return MAP_FAILED;
+  }
+  for (i = 0; i < page_cnt; i++)
+  {
+    void *upage = addr + i * PGSIZE;
+    if (!is_user_vaddr (upage) || (uint32_t)upage < (uint32_t) CODE_SEG
+        || spt_find_vaddr (cur->spt, upage) != NULL
+        || pagedir_get_page (cur->pagedir, upage) != NULL)
+    {
+      file_close (file);
+      return MAP_FAILED;
+    }
+  }
+
+  struct mmap_node *m = malloc (sizeof (struct mmap_node));
+  if (m == NULL)
+  {
+    file_close (file);
+    return MAP_FAILED;
+  }
+
+  m->mapid = ++cur->num_mapid;
+  m->file = file;
+  m->addr = addr;
+  m->page_cnt = 0;
+  list_push_back (&cur->mmap_list, &m->elem);
+
+  // one region covers the mapping, pages are loaded lazily on fault,
+  // straight from the file
+  if (!region_add (addr, page_cnt, file, 0, length, true, REGION_MMAP))
+  {
+    unmap_mmap_node (m);
+    return MAP_FAILED;
+  }
+  m->page_cnt = page_cnt;
+
+  spt_map_large (addr, page_cnt);
+
+  return m->mapid;
+}
+
+void sys_munmap (int mapid) {
+  struct mmap_node *node = find_mmap_node (mapid);
+  if (node != NULL)
+    unmap_mmap_node (node);
+}
+
+/**
+ * Purpose:
+ *  Reports the working set of the current process, as last estimated by
+ *  the sampler
+ *
+ * Args:
+ *  info {wsinfo*} User buffer to fill
+ *
+ * Returns:
+ *  {bool} True on success
+ */
+bool sys_wsinfo (struct wsinfo *info) {
+  pin_buffer (info, sizeof *info, true);
+
+  struct thread *cur = thread_current ();
+  info->ws_pages = cur->ws_size;
+  info->resident_pages = cur->ws_resident;
+  info->quota_pages = cur->frame_quota;
+  info->faults_per_sec = cur->fault_rate;
+  info->suspended = cur->vm_suspended;
+
+  page_unpin_range (info, sizeof *info);
+  return true;
+}
+
+/**
+ * Purpose:
+ *  Reports the fault, eviction and swap counters of the current process
+ *  or of the whole system
+ *
+ * Args:
+ *  st     {vmstat*} User buffer to fill
+ *  global    {bool} True for the system-wide counters
+ *
+ * Returns:
+ *  {bool} True on success
+ */
+bool sys_vmstat (struct vmstat *st, bool global) {
+  pin_buffer (st, sizeof *st, true);
+
+  vmstat_read (global ? NULL : thread_current (), st);
+
+  page_unpin_range (st, sizeof *st);
+  return true;
+}
+
+/**
+ * Purpose:
+ *  Advises the VM on how the current process will use a page aligned
+ *  range of its memory, see `page_advise`
+ *
+ * Args:
+ *  addr   {void*} Start of range, page aligned
+ *  length {size_t} Length of range in bytes
+ *  advice    {int} One of the MADV_* values
+ *
+ * Returns:
+ *  {bool} False if the range or the advice is invalid
+ */
+bool sys_madvise (void *addr, size_t length, int advice) {
+  return page_advise (addr, length, advice);
+}
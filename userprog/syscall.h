@@ -2,13 +2,18 @@
 #define USERPROG_SYSCALL_H
 
 #include "list.h"
+#include "threads/synch.h"
+
+struct thread;
 
 void syscall_init (void);
 
 struct file_node * find_file_node (int fd);
 void remove_all_file_node (struct list *list_ptr);
 
-struct lock file_sys_lock;
+/* Serializes the file system; taken after `ft_lock` when both are
+   held, never before it. */
+extern struct lock filesys_lock;
 
 struct file_node
 {
@@ -17,6 +22,20 @@ struct file_node
     struct list_elem elem;
 };
 
+struct mmap_node
+{
+    int mapid;
+    struct file *file;
+    void *addr;
+    size_t page_cnt;
+    struct list_elem elem;
+};
+
+void remove_all_mmap_node (struct list *list_ptr);
+
+bool copy_file_nodes (struct thread *parent);
+bool copy_mmap_nodes (struct thread *parent);
+
 void exit (int status);
 
 #endif /* userprog/syscall.h */
@@ -1,504 +1,2034 @@
 #include "stdio.h"
 #include <hash.h>
-#include "lib/kernel/list.h"
+#include <round.h>
+#include <stdint.h>
+#include <string.h>
+#include "devices/timer.h"
 #include "threads/malloc.h"
 #include "threads/palloc.h"
+#include "threads/synch.h"
 #include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "filesys/inode.h"
 #include "vm/frame.h"
+#include "vm/oom.h"
 #include "vm/page.h"
+#include "vm/repl.h"
 #include "vm/swap.h"
+#include "vm/vmstat.h"
+#include "userprog/syscall.h"
 
 #include "userprog/pagedir.h"
 
 void init_frame (void);
-void* get_frame (int flags, void* v_addr);
-struct ft_entry* eviction_algo (void);
-struct ft_entry* evict (struct list* f_table, struct list_elem* clock_hand);
+void* get_frame (int flags, struct spt_entry *spte);
+void free_frame (void *p_addr);
+void frame_pin (struct spt_entry *spte);
+bool frame_share_attach (struct spt_entry *spte);
+bool frame_share_reserve (struct spt_entry *spte, void *p_addr);
+void frame_share_cancel (void *p_addr);
+bool frame_fork_page (struct spt_entry *parent, struct spt_entry *child);
+bool frame_cow_claim (struct spt_entry *spte);
+void frame_share_publish (struct spt_entry *spte);
+void frame_share_detach (struct spt_entry *spte);
+bool frame_zero_map (struct spt_entry *spte);
+void frame_deactivate (struct spt_entry *spte);
+void frame_zero_unmap (struct spt_entry *spte);
+void* get_free_frame (int flags, struct spt_entry *spte);
+void* get_frames (int flags, struct spt_entry **sptes, size_t cnt);
+size_t frame_free_cnt (void);
+void frame_print_stats (void);
+void frame_sample (void);
+size_t frame_total_cnt (void);
+struct ft_entry *frame_lookup (void *p_addr);
 struct ft_entry* evict_test (void);
-void clock_hand_init(struct list_elem *clock_hand);
-void free_frame (struct ft_entry *victim);
+struct ft_entry *frame_at (size_t idx);
+bool frame_evictable (struct ft_entry *entry);
+bool frame_referenced (struct ft_entry *entry, bool clear);
+bool frame_dirty (struct ft_entry *entry);
+void frame_forget (struct spt_entry *spte);
+void frame_oom_score (void);
 
-struct list_elem* find_next_elem (struct list* list, struct list_elem* curr);
-struct ft_entry* find_ft_entry (void *v_addr);
+static size_t frame_index (void *p_addr);
+static void *try_get_frame (int flags, struct spt_entry *spte);
+static bool evict_needs_swap (struct ft_entry *entry);
+static struct ft_entry *evict_clean (void);
+static void clear_entry (struct ft_entry *entry);
+static bool share_drop (struct ft_entry *entry, struct spt_entry *spte);
+static void share_add (struct ft_entry *entry, struct spt_entry *spte);
+static unsigned share_hash (const struct hash_elem *e, void *aux);
+static bool share_less (const struct hash_elem *a, const struct hash_elem *b,
+                        void *aux);
+static struct ft_entry *evict_over_quota (void);
+static bool over_quota (struct thread *t);
+static void sample_page (struct ft_entry *entry, struct thread *t, void *v_addr);
+static void evict_frame (struct ft_entry *victim, struct spt_entry *spte,
+                         struct thread *t);
+static void pageout_kick (void);
+static void pageout_daemon (void *aux);
+static void merge_daemon (void *aux);
+static void merge_scan (struct ft_entry *entry);
+static bool merge_candidate (struct ft_entry *entry);
+static void merge_protect (struct spt_entry *spte);
+static void merge_requeue (struct ft_entry *entry, struct ft_entry *old);
+static unsigned merge_hash (const struct hash_elem *e, void *aux);
+static bool merge_less (const struct hash_elem *a, const struct hash_elem *b,
+                        void *aux);
+static void merge_forget (struct hash_elem *e, void *aux);
 
 // frame table lock
 struct lock ft_lock;
 
-// frame table list pointer
-struct list f_table;
+// frame table, flat array with one entry per frame of the user pool
+static struct ft_entry *f_table;
 
-// Clock hand pointer
-struct list_elem *clock_hand = NULL;
+// number of entries in frame table
+static size_t ft_size;
+
+// first frame of the user pool, frame table index 0
+static uint8_t *ft_base;
+
+// Separate hand for the scan over frames of processes above their quota
+static size_t quota_hand;
+
+// Evictions taken from processes above their frame quota
+static long long evict_quota_cnt;
+
+// Attempts at a frame made before the faulting process gives up, each
+// after `oom_kill` picked a victim
+#define OOM_RETRIES 10
+
+// Separate hand for the scan over frames that need no swap slot, and
+// the victims it replaced because swap was full
+static size_t clean_hand;
+static long long swap_full_cnt;
+
+// number of frames currently handed out
+static size_t ft_used;
+
+// shared text cache, frames of read-only executable pages by (inode, ofs)
+static struct hash share_table;
+
+// faults served from the shared text cache, each one a frame and a read saved
+static long long share_hit_cnt;
+
+// signalled with `ft_lock` whenever a text page read in flight finishes,
+// and the faults that waited for one instead of reading the page again
+static struct condition share_ready;
+static long long share_wait_cnt;
+
+// free frame watermarks, SIZE_MAX until `init_frame` picks a default
+size_t pageout_low = SIZE_MAX;
+size_t pageout_high = SIZE_MAX;
+
+// page-out daemon wake-up, `pageout_active` while it is reclaiming
+static struct semaphore pageout_wake;
+static bool pageout_active;
+
+// pinned placeholder holding a frame the daemon is writing back
+static struct spt_entry pageout_spte;
+
+// Frames reclaimed by faulting processes and by the page-out daemon
+static long long direct_reclaim_cnt;
+static long long background_reclaim_cnt;
+
+// all-zero kernel page mapped read-only for untouched zero-fill pages,
+// outside the user pool so it is never in the frame table or evicted
+static void *zero_frame;
+
+// zero frame mappings made, and those later replaced by a private frame
+static long long zero_map_cnt;
+static long long zero_cow_cnt;
+
+// Ticks between two batches of the same-page merging scanner
+#define MERGE_INTERVAL 10
+
+// frames hashed per batch by the merging scanner, 0 leaves it off
+size_t merge_scan_pages;
+
+// frames hashed in the current pass of the merging scanner, by checksum
+static struct hash merge_table;
+
+// next frame table index the merging scanner hashes
+static size_t merge_hand;
+
+// Frames freed by merging, frames hashed and cycles spent in scan batches
+static long long merge_cnt;
+static long long merge_scan_cnt;
+static uint64_t merge_cycles;
 
 /**
  * Purpose:
- *  Initializes frame table and LRU clock_hand
- * 
+ *  Initializes frame table and the replacement policy
+ *    * frame table is sized to cover the whole user pool, so it must
+ *      be called after `palloc_init()`
+ *
  * Args:
  *  None
- * 
+ *
  * Returns:
  *  None
  */
 void
 init_frame (void)
-{ 
+{
   // Initalize frame table lock
   lock_init(&ft_lock);
 
-  // Initialize list
-  // f_table = (struct list*) malloc (sizeof (struct list));
-  list_init(&f_table);
+  // Preallocate one entry per user frame from the kernel pool
+  ft_base = palloc_user_base ();
+  ft_size = palloc_user_page_cnt ();
+  f_table = palloc_get_multiple (PAL_ASSERT | PAL_ZERO,
+                                 DIV_ROUND_UP (ft_size * sizeof *f_table,
+                                               PGSIZE));
+
+  // Initialize replacement policy, picked by `-repl=NAME`
+  repl_policy->init (ft_size);
+
+  hash_init (&share_table, share_hash, share_less, NULL);
+  cond_init (&share_ready);
+
+  // Default watermarks at 1/32 and 1/16 of the user pool
+  if (pageout_low == SIZE_MAX)
+  {
+    pageout_low = ft_size / 32;
+  }
+  if (pageout_high == SIZE_MAX || pageout_high < pageout_low)
+  {
+    pageout_high = ft_size / 16 > pageout_low ? ft_size / 16 : pageout_low;
+  }
+  if (pageout_high > ft_size / 2)
+  {
+    pageout_high = ft_size / 2;
+  }
+
+  zero_frame = palloc_get_page (PAL_ASSERT | PAL_ZERO);
+
+  sema_init (&pageout_wake, 0);
+  pageout_spte.pinned = true;
+  thread_create ("pageout", PRI_DEFAULT, pageout_daemon, NULL);
 
-  // Initialize LRU clock hand
-  // clock_hand = (struct list_elem*) malloc (sizeof (struct list_elem));
-  clock_hand = NULL;
+  hash_init (&merge_table, merge_hash, merge_less, NULL);
+  if (merge_scan_pages > 0)
+  {
+    // lowest priority, the scanner only runs when nothing else can
+    thread_create ("merge", PRI_MIN, merge_daemon, NULL);
+  }
 
   return;
 }
 
+/**
+ * Purpose:
+ *  Translate frame address to its index in the frame table
+ *
+ * Args:
+ *  p_addr {void*} Physical mem. address of a user pool frame
+ *
+ * Returns:
+ *  {size_t} Frame table index
+ */
+static size_t
+frame_index (void *p_addr)
+{
+  size_t idx = ((uint8_t *) p_addr - ft_base) / PGSIZE;
+
+  ASSERT (pg_ofs (p_addr) == 0);
+  ASSERT ((uint8_t *) p_addr >= ft_base && idx < ft_size);
+
+  return idx;
+}
+
+/**
+ * Purpose:
+ *  Find frame table entry by physical frame address in O(1)
+ *
+ * Args:
+ *  p_addr {void*} Physical mem. address of a user pool frame
+ *
+ * Returns:
+ *  {ft_entry*} Frame table entry of the frame
+ */
+struct ft_entry *
+frame_lookup (void *p_addr)
+{
+  return &f_table[frame_index (p_addr)];
+}
+
 // THIS IS A GLOBAL FRAME TABLE ACCESS, IT NEEDS A LOCK TO PREVENT MULTI ACCESS
 /**
  * Purpose:
  *  Add element to frame table
- * 
+ *    * when the user pool is exhausted, a frame of any process is evicted
+ *      and the owner's page table and supplemental page table are updated
+ *    * when nothing can be evicted, `oom_kill` picks a process to exit
+ *      and the frame is tried again
+ *
  * Args:
- *  flags    {int} Enum of flags to be passed into `palloc_get_page`
- *  v_addr {void*} Virtual address
- * 
+ *  flags          {int} Enum of flags to be passed into `palloc_get_page`
+ *  spte    {spt_entry*} Supplemental page table entry of the page that
+ *                       will be loaded into the frame
+ *
  * Returns:
- *  {void*} Physical mem. address
- */ 
-
-int frame_count = 0;
+ *  {void*} Physical mem. address, NULL if memory ran out and the current
+ *          process should exit
+ */
 void*
-get_frame (int flags, void* v_addr)
+get_frame (int flags, struct spt_entry *spte)
+{
+  int tries;
+
+  for (tries = 0; ; tries++)
+  {
+    void *p_addr = try_get_frame (flags, spte);
+    if (p_addr != NULL || tries == OOM_RETRIES || !oom_kill ())
+    {
+      return p_addr;
+    }
+  }
+}
+
+/**
+ * Purpose:
+ *  Takes a free frame or evicts one, see `get_frame`
+ *
+ * Args:
+ *  flags          {int} Enum of flags to be passed into `palloc_get_page`
+ *  spte    {spt_entry*} Supplemental page table entry of the page that
+ *                       will be loaded into the frame
+ *
+ * Returns:
+ *  {void*} Physical mem. address, NULL if every frame is pinned or only
+ *          holds pages that need a swap slot while swap is full
+ */
+static void *
+try_get_frame (int flags, struct spt_entry *spte)
 {
-  // printf("hit get_frame!\n");
-  
   lock_acquire (&ft_lock);
-  // printf("ft lock acquired\n");
+
+  // an earlier copy of this page may still be on its way to swap,
+  // wait for that page alone before reading it back
+  if (spte->in_transit)
+  {
+    vmstat_count (thread_current (), VMSTAT_PIN_STALL);
+  }
+  while (spte->in_transit)
+  {
+    cond_wait (&spte->io_done, &ft_lock);
+  }
+
   // wrapped function, gets kpage
   struct thread *cur = thread_current();
   void *p_addr = palloc_get_page (flags);
+  struct ft_entry *entry = NULL;
 
-  // artificial limit of 10 pages on frame table to test swap
-  // void* p_addr = NULL;
-  // if(frame_count < 10)
-  // {  
-  //   p_addr = palloc_get_page (flags);
-  //   frame_count++;
-  // }
-  
-  // printf("Allocated: %p\n", p_addr);
-
-  // make new ft_entry
   if (p_addr != NULL)
   {
-    // consider case where malloc fails, returns NULL
-    struct ft_entry *entry = (struct ft_entry*) malloc (sizeof (struct ft_entry));
-    entry->v_addr = v_addr;
-    entry->p_addr = p_addr;
-    entry->curr = cur;
-    entry->used = 1;
-
-    list_push_back (&f_table, &entry->elem);
+    // claim the preallocated entry of the new frame
+    entry = frame_lookup (p_addr);
+    ft_used++;
   }
   else
   {
-    // kernel panic for now, change this to eviction algorithm (clock LRU)
-    // PANIC ("Out of memory!");
-
-    // Uncomment when evict() is working
-
-    // // find victim in frame table entry to evict
-    // struct ft_entry *victim = evict (&f_table, clock_hand);
+    // find victim in frame table entry to evict
     struct ft_entry *victim = evict_test();
-    // printf("evicted %p from %p\n", victim->v_addr, victim->p_addr);
-  
-    struct spt_entry *entry = spt_find_vaddr(cur->spt, victim->v_addr);
-    //printf("problem v.addr = %p\n", victim->v_addr);
-    p_addr = victim->p_addr;
-    pagedir_clear_page (cur->pagedir, victim->v_addr);
-    // lock_release (&ft_lock);
-    // printf("ft lock released\n");
-    //entry->pinned = true;
-    printf("problem v.addr = %p\n", victim->v_addr);
-
-    entry->swap_index = swap_put(victim->p_addr);
-    // if (pagedir_is_dirty (cur->pagedir, victim->v_addr))
-    // {
-    //   // send to swap
-    //   entry->swap_index = swap_put(victim->v_addr);
-    printf("return from swap = %p\n", victim->v_addr);
-    // }
-    entry->loaded = false;
-
-    // lock_acquire (&ft_lock);
-    // printf("ft lock acquired\n");
-
-    palloc_free_page(victim->p_addr);
-
-    victim->v_addr = v_addr;
+    if (victim == NULL)
+    {
+      // every frame pinned, or swap is full and no frame can be dropped
+      lock_release (&ft_lock);
+      return NULL;
+    }
 
-    entry->pinned = false;
-    // free(victim);
+    // no free frame, the faulting process reclaims one itself
+    direct_reclaim_cnt++;
+    p_addr = victim->p_addr;
+    entry = victim;
+    evict_frame (victim, spte, cur);
+  }
 
-    // p_addr = palloc_get_page(flags);
+  if (frame_free_cnt () < pageout_low)
+  {
+    pageout_kick ();
+  }
 
-    // printf("swap done\n");
-    // if (pagedir_is_dirty (cur->pagedir, victim->v_addr) || entry->is_stack)
-    // {
-    //   // send to swap
-    //   entry->swap_index = swap_put(victim->v_addr);
+  entry->v_addr = spte->v_addr;
+  entry->p_addr = p_addr;
+  entry->curr = cur;
+  entry->spte = spte;
+  entry->used = 1;
+  repl_policy->insert (entry);
 
-    // }
-  }
   lock_release (&ft_lock);
-  // printf("ft lock released\n");
-
-  // printf("load to %p\n", p_addr);
 
   return p_addr;
 }
 
 /**
  * Purpose:
- *  Algorithm for finding frame to evict, very basic for now, build it in
- *  complexity as you resolve more cases
- * 
- */ 
-struct ft_entry*
-eviction_algo (void)
+ *  Unmaps the page held in a frame and writes it back if dirty, leaving
+ *  the frame to a new holder; must be called with `ft_lock` held, which
+ *  is released during write-back
+ *
+ * Args:
+ *  victim {ft_entry*} Frame table entry picked by `evict_test`
+ *  spte  {spt_entry*} New holder of the frame, pinned
+ *  t        {thread*} Process of the new holder, NULL for the page-out
+ *                     daemon
+ *
+ * Returns:
+ *  None
+ */
+static void
+evict_frame (struct ft_entry *victim, struct spt_entry *spte, struct thread *t)
 {
-  struct list_elem *e;
-  // for (e = list_begin (&f_table); e != list_end (&f_table); e = list_next (e))
-  // {
-  //   struct ft_entry *k = list_entry (e, struct ft_entry, elem);
-  //   pagedir_is_dirty (thread_current ()->pagedir, k->v_addr);
+  void *p_addr = victim->p_addr;
 
-    
-  // }
+  if (victim->shared)
+  {
+    // frame mapped read-only by several processes, unmap it from every
+    // sharer; all of them hold the same content, so one copy is written
+    struct list evicted;
+    bool dirty = false;
 
-  e = list_begin (&f_table);
-  struct ft_entry *victim_ft = NULL;
-  struct spt_entry *victim_spt = NULL;
-  struct thread *cur = thread_current ();
-  bool isDirty = false;
-  bool pinned = false;
+    list_init (&evicted);
+    while (!list_empty (&victim->sharers))
+    {
+      struct spt_entry *sharer = list_entry (list_front (&victim->sharers),
+                                             struct spt_entry, share_elem);
+      dirty = dirty || sharer->dirty;
+      share_drop (victim, sharer);
+      list_push_back (&evicted, &sharer->share_elem);
+    }
 
-  int j = 0;
-  for (j = 0; j < 20; j++)
-  {
-    pinned = false;
+    victim->v_addr = spte->v_addr;
+    victim->curr = t;
+    victim->spte = spte;
 
-    // limit ft to 10 entries for now
-    // TODO impose 10 frame limit on frame table
-    if (j < 10)
+    if (dirty)
     {
-      victim_ft = list_entry (e, struct ft_entry, elem);
-      isDirty = pagedir_is_dirty (cur->pagedir, victim_ft->v_addr);
-      victim_spt = spt_find_vaddr (cur->spt, victim_ft->v_addr);
-      if(victim_spt != NULL)
+      // every sharer refers to the same swap slot, the eviction is
+      // charged to none of them
+      struct swap_req req;
+      struct list_elem *e;
+      uint32_t swap_index = swap_alloc (NULL);
+      ASSERT (swap_index != BITMAP_ERROR);
+      uint64_t start = vmstat_clock ();
+      for (e = list_begin (&evicted); e != list_end (&evicted);
+           e = list_next (e))
       {
-        pinned = victim_spt->pinned;
+        struct spt_entry *sharer = list_entry (e, struct spt_entry, share_elem);
+        if (e != list_begin (&evicted))
+        {
+          swap_dup (swap_index);
+        }
+        sharer->swap_index = swap_index;
+        sharer->in_transit = true;
       }
+      swap_put_async (&req, p_addr, swap_index);
+
+      lock_release (&ft_lock);
+      swap_wait (&req);
+      lock_acquire (&ft_lock);
+
+      vmstat_count (NULL, VMSTAT_EVICT_DIRTY);
+      vmstat_swap_out (NULL, start);
 
-      if (!pinned)
+      while (!list_empty (&evicted))
       {
-        return victim_ft;
+        struct spt_entry *sharer = list_entry (list_pop_front (&evicted),
+                                               struct spt_entry, share_elem);
+        sharer->in_transit = false;
+        cond_broadcast (&sharer->io_done, &ft_lock);
       }
-   
-      // if (isDirty)
-      // {
-      //   // no evict
-      // }
-      // else
-      // {
-      //   // always evict for now to test swapping
-      // }
-      
     }
-    else if (j == 10)
+    else
     {
-      e = list_begin (&f_table);
-      victim_ft = list_entry (e, struct ft_entry, elem);
-      isDirty = pagedir_is_dirty (cur->pagedir, victim_ft->v_addr);
-      victim_spt = spt_find_vaddr (cur->spt, victim_ft->v_addr);
-      if(victim_spt != NULL)
-      {
-        pinned = victim_spt->pinned;
-      }
+      vmstat_count (NULL, VMSTAT_EVICT_CLEAN);
+    }
+  }
+  else
+  {
+    // unmap the page from its owner, not from the faulting process
+    struct spt_entry *victim_spte = victim->spte;
+    struct thread *owner = victim->curr;
+    uint32_t *pd = owner->pagedir;
+    if (pagedir_is_dirty (pd, victim->v_addr))
+    {
+      victim_spte->dirty = true;
+    }
+    victim_spte->loaded = false;
+    victim_spte->p_addr = NULL;
+    pagedir_clear_page (pd, victim->v_addr);
 
-      if (!isDirty && !pinned)
-      {
-        return victim_ft;
-      }
+    // frame is handed over to its new holder in place, which is pinned,
+    // so no other evictor can pick it from here on
+    victim->v_addr = spte->v_addr;
+    victim->curr = t;
+    victim->spte = spte;
+
+    if (victim_spte->dirty && victim_spte->is_mmap)
+    {
+      // mapped file page, written back to its file instead of swap
+      victim_spte->in_transit = true;
+
+      lock_release (&ft_lock);
+      lock_acquire (&filesys_lock);
+      file_write_at (victim_spte->file_pt, p_addr, victim_spte->read_bytes,
+                     victim_spte->ofs);
+      lock_release (&filesys_lock);
+      lock_acquire (&ft_lock);
+
+      victim_spte->dirty = false;
+      victim_spte->in_transit = false;
+      cond_broadcast (&victim_spte->io_done, &ft_lock);
+
+      vmstat_count (owner, VMSTAT_EVICT_DIRTY);
     }
-    else
+    else if (victim_spte->dirty)
     {
-      // evict dirty as well
-      victim_ft = list_entry (e, struct ft_entry, elem);
-      isDirty = pagedir_is_dirty (cur->pagedir, victim_ft->v_addr);
+      // anonymous content, only swap can bring it back; the writeback
+      // thread does the I/O while other faults use the frame table
+      struct swap_req req;
+      uint64_t start = vmstat_clock ();
+      // `evict_test` checked that a slot is free
+      uint32_t swap_index = swap_alloc (victim_spte);
+      ASSERT (swap_index != BITMAP_ERROR);
+      victim_spte->swap_index = swap_index;
+      victim_spte->in_transit = true;
+      swap_put_async (&req, p_addr, victim_spte->swap_index);
 
-      victim_spt = spt_find_vaddr (cur->spt, victim_ft->v_addr);
-      if(victim_spt != NULL)
-      {
-        pinned = victim_spt->pinned;
-      }
+      lock_release (&ft_lock);
+      swap_wait (&req);
+      lock_acquire (&ft_lock);
 
-      if (!pinned)
-      {
-        return victim_ft;
-      }
+      victim_spte->in_transit = false;
+      cond_broadcast (&victim_spte->io_done, &ft_lock);
+
+      vmstat_count (owner, VMSTAT_EVICT_DIRTY);
+      vmstat_swap_out (owner, start);
+    }
+    else
+    {
+      // clean page, dropped and reloaded from file or re-zeroed on fault
+      vmstat_count (owner, VMSTAT_EVICT_CLEAN);
     }
-    e = find_next_elem (&f_table, e);
-    
   }
-  return NULL;
+
+  return;
 }
 
 /**
  * Purpose:
- *  Returns frame table entry of frame to evict
- * 
+ *  Wakes the page-out daemon unless it is already reclaiming, must be
+ *  called with `ft_lock` held
+ *
  * Args:
- *  f_table         {list*} Pointer to frame table list
- *  clock_hand {list_elem*} Pointer to last clock hand position
- * 
+ *  None
+ *
  * Returns:
- *  {ft_entry*} Frame table entry of evicted frame
+ *  None
  */
-struct ft_entry*
-evict_test (void)
+static void
+pageout_kick (void)
 {
-  int table_size = list_size(&f_table);
-  struct thread* cur = thread_current();
-  bool pinned = false;
+  if (!pageout_active)
+  {
+    pageout_active = true;
+    sema_up (&pageout_wake);
+  }
+}
 
-  // printf("tablesize: %d", table_size);
-  //ASSERT(table_size != 0);
-  int iter = 0;
-  for (iter = 0; iter < 2 * table_size ; iter++){
+/**
+ * Purpose:
+ *  Page-out daemon, once free frames drop below `pageout_low` it evicts
+ *  with the same policy as direct reclaim until `pageout_high` frames are
+ *  free, so dirty pages are written back before a fault needs their frame
+ *    * `ft_lock` is dropped and the CPU yielded between frames, so faults
+ *      are not held up for a whole batch
+ *
+ * Args:
+ *  aux {void*} Unused
+ *
+ * Returns:
+ *  None
+ */
+static void
+pageout_daemon (void *aux UNUSED)
+{
+  for (;;)
+  {
+    sema_down (&pageout_wake);
 
-    if (clock_hand == NULL || clock_hand == list_end(&f_table)){
-      clock_hand = list_begin(&f_table);
-    }
-    else{
-      clock_hand = list_next(clock_hand);
-    }
-    struct ft_entry *victim = list_entry(clock_hand, struct ft_entry, elem);
-   
-    if(pagedir_is_accessed(cur->pagedir, victim->v_addr)) {
-      pagedir_set_accessed(cur->pagedir, victim->v_addr, false);
-    }
-    else{
-      
-      struct spt_entry *victim_spt = spt_find_vaddr (cur->spt, victim->v_addr);
-      if(victim_spt != NULL)
+    lock_acquire (&ft_lock);
+    while (ft_size - ft_used < pageout_high)
+    {
+      struct ft_entry *victim = evict_test ();
+      if (victim == NULL)
       {
-        pinned = victim_spt->pinned;
+        // everything pinned or in use, leave the rest to direct reclaim
+        break;
       }
 
-      if (!pinned)
+      void *p_addr = victim->p_addr;
+      evict_frame (victim, &pageout_spte, NULL);
+      clear_entry (victim);
+      palloc_free_page (p_addr);
+      background_reclaim_cnt++;
+
+      // a fault woken by the release must get to run before the daemon
+      // takes the lock back
+      lock_release (&ft_lock);
+      thread_yield ();
+      lock_acquire (&ft_lock);
+    }
+    pageout_active = false;
+    lock_release (&ft_lock);
+  }
+}
+
+/**
+ * Purpose:
+ *  Same-page merging scanner, hashes `merge_scan_pages` frames every
+ *  `MERGE_INTERVAL` ticks and merges identical anonymous pages
+ *    * a pass over the whole frame table starts with an empty
+ *      `merge_table`, so checksums of pages changed since are dropped
+ *
+ * Args:
+ *  aux {void*} Unused
+ *
+ * Returns:
+ *  None
+ */
+static void
+merge_daemon (void *aux UNUSED)
+{
+  for (;;)
+  {
+    timer_sleep (MERGE_INTERVAL);
+
+    uint64_t start = vmstat_clock ();
+    size_t i;
+    for (i = 0; i < merge_scan_pages; i++)
+    {
+      merge_scan (&f_table[merge_hand]);
+
+      merge_hand = (merge_hand + 1) % ft_size;
+      if (merge_hand == 0)
       {
-        return victim;
+        lock_acquire (&ft_lock);
+        hash_clear (&merge_table, merge_forget);
+        lock_release (&ft_lock);
       }
-      
     }
-
+    merge_cycles += vmstat_clock () - start;
   }
-  return NULL;
 }
 
-// /**
-//  * Purpose:
-//  *  Returns frame table entry of frame to evict
-//  * 
-//  * Args:
-//  *  f_table         {list*} Pointer to frame table list
-//  *  clock_hand {list_elem*} Pointer to last clock hand position
-//  * 
-//  * Returns:
-//  *  {ft_entry*} Frame table entry of evicted frame
-//  */
-// struct ft_entry*
-// evict (struct list *f_table, struct list_elem *clock_hand)
-// {
-//   lock_acquire (&ft_lock);
-
-//   // Maximum number of cycles that LRU clock can turn
-//   const int MAX_CYCLES = 4;
-//   const int RESET_VAL = 0;
-
-//   // Number of cycles run by clock LRU
-//   int num_cycle = 0;
-  
-//   // try to evict clean pages first
-//   bool evict_dirty = false;
-
-//   // initial clock position
-//   struct list_elem* init_pos = clock_hand;
-
-//   // frame table entry of victim to be evicted
-//   struct ft_entry *victim = NULL;
-//   struct ft_entry *curr_entry = NULL;
-
-//   while ((num_cycle < MAX_CYCLES) && (victim == NULL))
-//   {
-//     curr_entry = list_entry (clock_hand, struct ft_entry, elem);
-
-//     if (!evict_dirty)
-//     {
-//       // do not evict dirty pages
-//       if (curr_entry->used == RESET_VAL && !curr_entry->used)
-//       {
-//         // find victim if not dirty, used == 0
-//         victim = curr_entry;
-//       }
-//       else
-//       {
-//         // reset used bit
-//         curr_entry->used = RESET_VAL;
-//       }
-//     }
-//     else
-//     {
-//       // allow dirty page eviction
-//       if (curr_entry->used == RESET_VAL)
-//       {
-//         // find victim if not dirty, used == 0
-//         victim = curr_entry;
-//       }
-//       else
-//       {
-//         // reset used bit
-//         curr_entry->used = RESET_VAL;
-//       }
-//     }
-    
-//     if (num_cycle >= MAX_CYCLES / 2)
-//     {
-//       // allow dirty page eviction after one revolution
-//       evict_dirty = true;
-//     }
-
-//     // Advance to next element
-//     clock_hand = find_next_elem (f_table, clock_hand);
-//     if (clock_hand == init_pos)
-//     {
-//       // increment cycle count after one revolution
-//       num_cycle++;
-//     }
-//   }
-//   lock_release (&ft_lock);
-
-//   return victim;
-// }
-
-// /**
-//  * Purpose:
-//  *  Initialize clock hand
-//  * 
-//  * Args:
-//  *  clock_hand {list_elem*} Pointer to last clock hand position
-//  * 
-//  * Returns:
-//  *  None
-//  */
-// void
-// clock_hand_init(struct list_elem *clock_hand)
-// {
-//   if(clock_hand == NULL)
-//   {
-//     // set clock hand to beginning if NULL
-//     clock_hand = list_begin(&f_table);
-//   }
-
-//   return;
-// }
-
-// /**
-//  * Purpose:
-//  *  Frees frame table entry and its associated frame
-//  * 
-//  * Args:
-//  *  victim {ft_entry*} Frame table entry to free
-//  * 
-//  * Returns:
-//  *  None
-//  */ 
-// void
-// free_frame (struct ft_entry *victim)
-// {
-//   lock_acquire (&ft_lock);
-  
-//   list_remove(&victim->elem);
-
-//   palloc_free_page(victim->p_addr);
-
-//   free(victim);
-
-//   lock_release (&ft_lock);
-
-//   return;
-// }
-
-/**
- * Purpose:
- *  Finds next element in list
- * 
- * Args:
- *  list {list*}      Pointer to list structure
- *  curr {list_elem*} Pointer to current list element
- * 
- * Returns:
- *  {list_elem*} Pointer to next list element
- */ 
-struct list_elem*
-find_next_elem (struct list* list, struct list_elem* curr)
-{
-  // TODO: guard against case where list becomes empty
-  if (curr == list_end (list))
-  {
-    // curr has reached tail, set to first element of list
-    curr = list_begin (list);
+/**
+ * Purpose:
+ *  Hashes one frame and merges it into an earlier frame of this pass with
+ *  the same content, which becomes a read-only shared frame
+ *    * the page is hashed without `ft_lock`, a checksum match is
+ *      confirmed with both pages write-protected and the lock held, so
+ *      neither can change until the merge is done
+ *    * a later store to either page faults into `cow_fault`
+ *
+ * Args:
+ *  entry {ft_entry*} Frame table entry under the scanner's hand
+ *
+ * Returns:
+ *  None
+ */
+static void
+merge_scan (struct ft_entry *entry)
+{
+  lock_acquire (&ft_lock);
+  if (entry->shared || !merge_candidate (entry))
+  {
+    lock_release (&ft_lock);
+    return;
+  }
+  struct spt_entry *spte = entry->spte;
+  void *p_addr = entry->p_addr;
+  lock_release (&ft_lock);
+
+  unsigned checksum = hash_bytes (p_addr, PGSIZE);
+  merge_scan_cnt++;
+
+  lock_acquire (&ft_lock);
+
+  // page may have been evicted or freed while it was hashed
+  if (entry->spte != spte || entry->p_addr != p_addr || entry->shared
+      || !merge_candidate (entry))
+  {
+    lock_release (&ft_lock);
+    return;
   }
-  else
+
+  if (entry->merge_queued)
+  {
+    hash_delete (&merge_table, &entry->merge_elem);
+    entry->merge_queued = false;
+  }
+  entry->checksum = checksum;
+
+  struct hash_elem *found = hash_insert (&merge_table, &entry->merge_elem);
+  if (found == NULL)
+  {
+    // first page of this pass with this checksum
+    entry->merge_queued = true;
+    lock_release (&ft_lock);
+    return;
+  }
+
+  struct ft_entry *match = hash_entry (found, struct ft_entry, merge_elem);
+  if (!merge_candidate (match))
+  {
+    merge_requeue (entry, match);
+    lock_release (&ft_lock);
+    return;
+  }
+
+  merge_protect (spte);
+  if (!match->shared)
+  {
+    merge_protect (match->spte);
+  }
+
+  if (memcmp (p_addr, match->p_addr, PGSIZE) != 0)
+  {
+    // checksum collision or stale checksum, both pages stay private and
+    // regain write access on their next store
+    merge_requeue (entry, match);
+    lock_release (&ft_lock);
+    return;
+  }
+
+  if (!match->shared)
+  {
+    share_add (match, match->spte);
+  }
+
+  uint32_t *pd = spte->owner->pagedir;
+  pagedir_clear_page (pd, spte->v_addr);
+  pagedir_set_page (pd, spte->v_addr, match->p_addr, false);
+  share_add (match, spte);
+  spte->p_addr = match->p_addr;
+
+  clear_entry (entry);
+  palloc_free_page (p_addr);
+  merge_cnt++;
+
+  lock_release (&ft_lock);
+}
+
+/**
+ * Purpose:
+ *  Checks if a frame holds a page the merging scanner may merge, must be
+ *  called with `ft_lock` held
+ *    * only loaded, writable, anonymous pages qualify, mapped files and
+ *      the shared text cache are left alone
+ *
+ * Args:
+ *  entry {ft_entry*} Frame table entry
+ *
+ * Returns:
+ *  {bool} True if the page may be merged
+ */
+static bool
+merge_candidate (struct ft_entry *entry)
+{
+  struct spt_entry *spte = entry->spte;
+
+  return entry->p_addr != NULL && entry->curr != NULL && spte != NULL
+         && entry->inode == NULL && spte->loaded && spte->writable
+         && !spte->is_mmap && !spte->pinned && !spte->in_transit;
+}
+
+/**
+ * Purpose:
+ *  Write-protects a private page, keeping its dirty bit in the
+ *  supplemental page table entry; must be called with `ft_lock` held
+ *    * the scanner runs on the kernel page directory, so no stale TLB
+ *      entry of the owner survives the next switch to it
+ *
+ * Args:
+ *  spte {spt_entry*} Supplemental page table entry of the page
+ *
+ * Returns:
+ *  None
+ */
+static void
+merge_protect (struct spt_entry *spte)
+{
+  uint32_t *pd = spte->owner->pagedir;
+
+  if (pagedir_is_dirty (pd, spte->v_addr))
   {
-    curr = list_next (curr);
-  }
-
-  return curr;
-}
-
-// /**
-//  * Purpose:
-//  *  Find frame table entry by virtual address
-//  * 
-//  * Args:
-//  *  v_addr {void*} Virtual address
-//  * 
-//  * Returns:
-//  *  {ft_entry*} Pointer to frame table entry of passed in virtual address,
-//  *              NULL if nothing found 
-//  */ 
-// struct ft_entry *
-// find_ft_entry (void *v_addr)
-// {
-//   struct list_elem *e;
-//   for (e = list_begin (&f_table); e != list_end (&f_table); e = list_next (e))
-//   {
-//     struct ft_entry *k = list_entry (e, struct ft_entry, elem);
-//     if((uint32_t)(k->v_addr) == (uint32_t)v_addr)
-//     {
-//       return k;
-//     }
-//   }
-//   return NULL;
-// }
-
-// void* free_frame ()
-// {
-  
-// }
+    spte->dirty = true;
+  }
+  pagedir_clear_page (pd, spte->v_addr);
+  pagedir_set_page (pd, spte->v_addr, spte->p_addr, false);
+}
+
+/**
+ * Purpose:
+ *  Replaces a frame in the merge table by a newer frame with the same
+ *  checksum, must be called with `ft_lock` held
+ *
+ * Args:
+ *  entry {ft_entry*} Frame just hashed
+ *  old   {ft_entry*} Frame in the table with the same checksum
+ *
+ * Returns:
+ *  None
+ */
+static void
+merge_requeue (struct ft_entry *entry, struct ft_entry *old)
+{
+  hash_replace (&merge_table, &entry->merge_elem);
+  old->merge_queued = false;
+  entry->merge_queued = true;
+}
+
+/**
+ * Purpose:
+ *  Hashes a frame in the merge table by the checksum of its content
+ *
+ * Args:
+ *  e {hash_elem*} Hash element of the frame table entry
+ *  aux    {void*} Unused
+ *
+ * Returns:
+ *  {unsigned} Hash value
+ */
+static unsigned
+merge_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  return hash_entry (e, struct ft_entry, merge_elem)->checksum;
+}
+
+/**
+ * Purpose:
+ *  Orders frames in the merge table by checksum
+ *
+ * Args:
+ *  a {hash_elem*} Hash element of the first frame table entry
+ *  b {hash_elem*} Hash element of the second frame table entry
+ *  aux    {void*} Unused
+ *
+ * Returns:
+ *  {bool} True if `a` sorts before `b`
+ */
+static bool
+merge_less (const struct hash_elem *a, const struct hash_elem *b,
+            void *aux UNUSED)
+{
+  return hash_entry (a, struct ft_entry, merge_elem)->checksum
+         < hash_entry (b, struct ft_entry, merge_elem)->checksum;
+}
+
+/**
+ * Purpose:
+ *  Marks a frame as no longer in the merge table, when a pass starts over
+ *
+ * Args:
+ *  e {hash_elem*} Hash element of the frame table entry
+ *  aux    {void*} Unused
+ *
+ * Returns:
+ *  None
+ */
+static void
+merge_forget (struct hash_elem *e, void *aux UNUSED)
+{
+  hash_entry (e, struct ft_entry, merge_elem)->merge_queued = false;
+}
+
+/**
+ * Purpose:
+ *  Add element to frame table only if a frame is free, never evicts
+ *    * used for opportunistic loads such as swap readahead
+ *
+ * Args:
+ *  flags          {int} Enum of flags to be passed into `palloc_get_page`
+ *  spte    {spt_entry*} Supplemental page table entry of the page that
+ *                       will be loaded into the frame
+ *
+ * Returns:
+ *  {void*} Physical mem. address, NULL if no frame is free or the page
+ *          is still being written to swap
+ */
+void*
+get_free_frame (int flags, struct spt_entry *spte)
+{
+  void *p_addr = NULL;
+
+  lock_acquire (&ft_lock);
+
+  if (!spte->in_transit)
+  {
+    p_addr = palloc_get_page (flags);
+  }
+
+  if (p_addr != NULL)
+  {
+    struct ft_entry *entry = frame_lookup (p_addr);
+    entry->v_addr = spte->v_addr;
+    entry->p_addr = p_addr;
+    entry->curr = thread_current ();
+    entry->spte = spte;
+    entry->used = 1;
+    ft_used++;
+    repl_policy->insert (entry);
+  }
+
+  lock_release (&ft_lock);
+
+  return p_addr;
+}
+
+/**
+ * Purpose:
+ *  Add a run of physically contiguous frames to frame table, never evicts
+ *    * frames are contiguous in kernel virtual memory too, so one
+ *      `file_read` can fill all of them
+ *
+ * Args:
+ *  flags           {int} Enum of flags to be passed into `palloc_get_multiple`
+ *  sptes   {spt_entry**} Supplemental page table entries, one per frame
+ *  cnt          {size_t} Number of frames
+ *
+ * Returns:
+ *  {void*} Physical mem. address of first frame, NULL if no run of `cnt`
+ *          free frames exists
+ */
+void*
+get_frames (int flags, struct spt_entry **sptes, size_t cnt)
+{
+  struct thread *cur = thread_current ();
+  size_t i;
+
+  lock_acquire (&ft_lock);
+
+  uint8_t *p_addr = palloc_get_multiple (flags, cnt);
+  if (p_addr != NULL)
+  {
+    for (i = 0; i < cnt; i++)
+    {
+      struct ft_entry *entry = frame_lookup (p_addr + i * PGSIZE);
+      entry->v_addr = sptes[i]->v_addr;
+      entry->p_addr = p_addr + i * PGSIZE;
+      entry->curr = cur;
+      entry->spte = sptes[i];
+      entry->used = 1;
+      repl_policy->insert (entry);
+    }
+    ft_used += cnt;
+  }
+
+  lock_release (&ft_lock);
+
+  return p_addr;
+}
+
+/**
+ * Purpose:
+ *  Number of user frames not handed out, a hint only since it is read
+ *  without `ft_lock`
+ *
+ * Args:
+ *  None
+ *
+ * Returns:
+ *  {size_t} Free frame count
+ */
+size_t
+frame_free_cnt (void)
+{
+  return ft_size - ft_used;
+}
+
+/**
+ * Purpose:
+ *  Number of frames in the user pool
+ *
+ * Args:
+ *  None
+ *
+ * Returns:
+ *  {size_t} Frame count
+ */
+size_t
+frame_total_cnt (void)
+{
+  return ft_size;
+}
+
+/**
+ * Purpose:
+ *  Samples and clears the accessed bits of every mapped frame, adding up
+ *  resident and referenced frames in each owner's working set counters
+ *    * a referenced frame keeps its second chance in `used`, since its
+ *      accessed bit is gone
+ *
+ * Args:
+ *  None
+ *
+ * Returns:
+ *  None
+ */
+void
+frame_sample (void)
+{
+  size_t i;
+
+  lock_acquire (&ft_lock);
+
+  for (i = 0; i < ft_size; i++)
+  {
+    struct ft_entry *entry = &f_table[i];
+    if (entry->p_addr == NULL)
+    {
+      continue;
+    }
+
+    if (entry->shared)
+    {
+      struct list_elem *e;
+      for (e = list_begin (&entry->sharers); e != list_end (&entry->sharers);
+           e = list_next (e))
+      {
+        struct spt_entry *sharer = list_entry (e, struct spt_entry, share_elem);
+        sample_page (entry, sharer->owner, sharer->v_addr);
+      }
+    }
+    else if (entry->curr != NULL)
+    {
+      sample_page (entry, entry->curr, entry->v_addr);
+    }
+  }
+
+  lock_release (&ft_lock);
+}
+
+/**
+ * Purpose:
+ *  Counts one mapping of a frame in its owner's working set counters,
+ *  must be called with `ft_lock` held
+ *
+ * Args:
+ *  entry {ft_entry*} Frame table entry
+ *  t       {thread*} Process mapping the frame
+ *  v_addr    {void*} Virtual address of the mapping
+ *
+ * Returns:
+ *  None
+ */
+static void
+sample_page (struct ft_entry *entry, struct thread *t, void *v_addr)
+{
+  t->ws_resident_acc++;
+  if (pagedir_is_accessed (t->pagedir, v_addr))
+  {
+    pagedir_set_accessed (t->pagedir, v_addr, false);
+    entry->used = 1;
+    t->ws_acc++;
+  }
+}
+
+/**
+ * Purpose:
+ *  Prints eviction statistics at shutdown
+ *
+ * Args:
+ *  None
+ *
+ * Returns:
+ *  None
+ */
+void
+frame_print_stats (void)
+{
+  printf ("Frame: %lld text faults served from shared frames, "
+          "%lld waited for a read in flight\n", share_hit_cnt, share_wait_cnt);
+  printf ("Frame: %lld evictions from processes over quota\n",
+          evict_quota_cnt);
+  printf ("Frame: %lld frames reclaimed directly, %lld in background\n",
+          direct_reclaim_cnt, background_reclaim_cnt);
+  if (swap_full_cnt > 0)
+  {
+    printf ("Frame: %lld victims passed over with swap full\n",
+            swap_full_cnt);
+  }
+  printf ("Frame: %lld zero page mappings, %lld copied on write, "
+          "%lld frames saved\n", zero_map_cnt, zero_cow_cnt,
+          zero_map_cnt - zero_cow_cnt);
+  if (merge_scan_pages > 0)
+  {
+    printf ("Frame: %lld frames merged, %lld scanned in %llu cycles\n",
+            merge_cnt, merge_scan_cnt, merge_cycles);
+  }
+}
+
+/**
+ * Purpose:
+ *  Maps an untouched zero-fill page read-only to the shared zero frame
+ *    * only pages whose contents are all zeros qualify: stack pages and
+ *      BSS pages with nothing to read, never swapped or written
+ *    * the page stays not `loaded`, the first write faults and
+ *      `load_vaddr` gives it a frame of its own
+ *
+ * Args:
+ *  spte {spt_entry*} Supplemental page table entry of the faulting page,
+ *                    owned by the current thread
+ *
+ * Returns:
+ *  {bool} True if the zero frame was mapped
+ */
+bool
+frame_zero_map (struct spt_entry *spte)
+{
+  if (spte->loaded || spte->zero_page || spte->is_mmap || spte->dirty
+      || spte->swap_index != -1 || spte->read_bytes != 0)
+  {
+    return false;
+  }
+
+  if (!pagedir_set_page (spte->owner->pagedir, spte->v_addr, zero_frame,
+                         false))
+  {
+    return false;
+  }
+
+  spte->zero_page = true;
+  zero_map_cnt++;
+  vmstat_count (spte->owner, VMSTAT_MINOR);
+
+  return true;
+}
+
+/**
+ * Purpose:
+ *  Removes the zero frame mapping of a page about to get its own frame
+ *
+ * Args:
+ *  spte {spt_entry*} Supplemental page table entry mapped to the zero
+ *                    frame
+ *
+ * Returns:
+ *  None
+ */
+void
+frame_zero_unmap (struct spt_entry *spte)
+{
+  ASSERT (spte->zero_page);
+
+  pagedir_clear_page (spte->owner->pagedir, spte->v_addr);
+  spte->zero_page = false;
+  zero_cow_cnt++;
+}
+
+/**
+ * Purpose:
+ *  Maps a read-only executable page from the shared text cache
+ *    * lookup and mapping happen under `ft_lock`, so the frame can not
+ *      be evicted in between and the sharer needs no pin
+ *    * a page another process is still reading is waited for, the
+ *      lookup is repeated as the read may also have failed
+ *
+ * Args:
+ *  spte {spt_entry*} Supplemental page table entry of the faulting page
+ *
+ * Returns:
+ *  {bool} True if the page was found in the cache and mapped
+ */
+bool
+frame_share_attach (struct spt_entry *spte)
+{
+  struct ft_entry key;
+  struct ft_entry *entry;
+
+  key.inode = file_get_inode (spte->file_pt);
+  key.ofs = spte->ofs;
+  key.read_bytes = spte->read_bytes;
+
+  lock_acquire (&ft_lock);
+
+  for (;;)
+  {
+    struct hash_elem *found = hash_find (&share_table, &key.share_elem);
+    if (found == NULL)
+    {
+      lock_release (&ft_lock);
+      return false;
+    }
+
+    entry = hash_entry (found, struct ft_entry, share_elem);
+    if (!entry->share_busy)
+    {
+      break;
+    }
+    share_wait_cnt++;
+    cond_wait (&share_ready, &ft_lock);
+  }
+
+  share_add (entry, spte);
+  spte->loaded = true;
+  spte->p_addr = entry->p_addr;
+  pagedir_set_page (spte->owner->pagedir, spte->v_addr, entry->p_addr, false);
+  share_hit_cnt++;
+
+  lock_release (&ft_lock);
+
+  return true;
+}
+
+/**
+ * Purpose:
+ *  Claims a read-only executable page in the shared text cache before
+ *  it is read, so processes faulting on it meanwhile wait for this read
+ *  instead of starting their own
+ *    * the frame enters the cache busy, `frame_share_publish` or
+ *      `frame_share_cancel` ends the read
+ *
+ * Args:
+ *  spte {spt_entry*} Supplemental page table entry of the page, pinned
+ *  p_addr   {void*} Frame from `get_frame` the page will be read into
+ *
+ * Returns:
+ *  {bool} False if the page is already in the cache or being read,
+ *         `frame_share_attach` then maps that copy
+ */
+bool
+frame_share_reserve (struct spt_entry *spte, void *p_addr)
+{
+  bool reserved = true;
+
+  lock_acquire (&ft_lock);
+
+  struct ft_entry *entry = frame_lookup (p_addr);
+  entry->inode = file_get_inode (spte->file_pt);
+  entry->ofs = spte->ofs;
+  entry->read_bytes = spte->read_bytes;
+
+  if (hash_insert (&share_table, &entry->share_elem) != NULL)
+  {
+    entry->inode = NULL;
+    reserved = false;
+  }
+  else
+  {
+    entry->share_busy = true;
+  }
+
+  lock_release (&ft_lock);
+
+  return reserved;
+}
+
+/**
+ * Purpose:
+ *  Ends the read of a page reserved with `frame_share_reserve` that did
+ *  not complete, waiters look it up again and read it themselves
+ *
+ * Args:
+ *  p_addr {void*} Reserved frame, still allocated
+ *
+ * Returns:
+ *  None
+ */
+void
+frame_share_cancel (void *p_addr)
+{
+  lock_acquire (&ft_lock);
+
+  struct ft_entry *entry = frame_lookup (p_addr);
+  if (entry->share_busy)
+  {
+    hash_delete (&share_table, &entry->share_elem);
+    entry->inode = NULL;
+    entry->share_busy = false;
+    cond_broadcast (&share_ready, &ft_lock);
+  }
+
+  lock_release (&ft_lock);
+}
+
+/**
+ * Purpose:
+ *  Ends the read of a page reserved with `frame_share_reserve`, making
+ *  the mapped frame shared and waking processes waiting for it
+ *
+ * Args:
+ *  spte {spt_entry*} Supplemental page table entry of the loaded page
+ *
+ * Returns:
+ *  None
+ */
+void
+frame_share_publish (struct spt_entry *spte)
+{
+  lock_acquire (&ft_lock);
+
+  struct ft_entry *entry = frame_lookup (spte->p_addr);
+  ASSERT (entry->share_busy);
+
+  entry->share_busy = false;
+  share_add (entry, spte);
+  cond_broadcast (&share_ready, &ft_lock);
+
+  lock_release (&ft_lock);
+
+  return;
+}
+
+/**
+ * Purpose:
+ *  Gives a forked child the parent's copy of a page
+ *    * a loaded page becomes a shared frame mapped read-only in both
+ *      processes, the first write to it faults and copies it
+ *    * a swapped page's slot gains a reference
+ *    * runs under `ft_lock`, after any eviction of the page has finished
+ *
+ * Args:
+ *  parent {spt_entry*} Parent's supplemental page table entry
+ *  child  {spt_entry*} Child's entry, a copy of `parent` owned by the
+ *                      current thread
+ *
+ * Returns:
+ *  {bool} False if the child's page table could not be extended
+ */
+bool
+frame_fork_page (struct spt_entry *parent, struct spt_entry *child)
+{
+  bool success = true;
+
+  lock_acquire (&ft_lock);
+
+  if (parent->in_transit)
+  {
+    vmstat_count (thread_current (), VMSTAT_PIN_STALL);
+  }
+  while (parent->in_transit)
+  {
+    cond_wait (&parent->io_done, &ft_lock);
+  }
+
+  child->dirty = parent->dirty;
+  child->swap_index = parent->swap_index;
+
+  if (parent->loaded)
+  {
+    struct ft_entry *entry = frame_lookup (parent->p_addr);
+    uint32_t *pd = parent->owner->pagedir;
+
+    if (pagedir_is_dirty (pd, parent->v_addr))
+    {
+      parent->dirty = true;
+      child->dirty = true;
+    }
+
+    if (!entry->shared)
+    {
+      share_add (entry, parent);
+
+      // write-protect the parent's mapping, the child blocks the parent
+      // until fork returns, so its stale TLB entry is dropped on switch
+      pagedir_clear_page (pd, parent->v_addr);
+      pagedir_set_page (pd, parent->v_addr, parent->p_addr, false);
+    }
+
+    success = pagedir_set_page (child->owner->pagedir, child->v_addr,
+                                parent->p_addr, false);
+    if (success)
+    {
+      share_add (entry, child);
+      child->loaded = true;
+      child->p_addr = parent->p_addr;
+    }
+  }
+  else if (parent->swap_index != -1)
+  {
+    swap_dup (parent->swap_index);
+  }
+
+  lock_release (&ft_lock);
+
+  return success;
+}
+
+/**
+ * Purpose:
+ *  Makes a copy-on-write page writable in place if no other process
+ *  maps its frame any more
+ *
+ * Args:
+ *  spte {spt_entry*} Supplemental page table entry of the faulting page
+ *
+ * Returns:
+ *  {bool} True if the page is now writable or was evicted meanwhile,
+ *         false if it must be copied
+ */
+bool
+frame_cow_claim (struct spt_entry *spte)
+{
+  bool claimed = false;
+
+  lock_acquire (&ft_lock);
+
+  if (!spte->loaded)
+  {
+    // evicted since the fault, the retried access faults it back in
+    lock_release (&ft_lock);
+    return true;
+  }
+
+  struct ft_entry *entry = frame_lookup (spte->p_addr);
+  if (!entry->shared || (entry->ref_cnt == 1 && entry->inode == NULL))
+  {
+    if (entry->shared)
+    {
+      // last sharer, frame becomes private again
+      list_remove (&spte->share_elem);
+      spte->shared = false;
+      entry->shared = false;
+      entry->ref_cnt = 0;
+      entry->spte = spte;
+      entry->curr = spte->owner;
+      entry->v_addr = spte->v_addr;
+    }
+
+    pagedir_clear_page (spte->owner->pagedir, spte->v_addr);
+    pagedir_set_page (spte->owner->pagedir, spte->v_addr, spte->p_addr, true);
+    spte->dirty = true;
+    claimed = true;
+  }
+
+  lock_release (&ft_lock);
+
+  return claimed;
+}
+
+/**
+ * Purpose:
+ *  Unmaps one sharer of a shared frame, freeing the frame with the
+ *  last sharer
+ *
+ * Args:
+ *  spte {spt_entry*} Supplemental page table entry of the sharer
+ *
+ * Returns:
+ *  None
+ */
+void
+frame_share_detach (struct spt_entry *spte)
+{
+  lock_acquire (&ft_lock);
+
+  struct ft_entry *entry = frame_lookup (spte->p_addr);
+  if (share_drop (entry, spte))
+  {
+    palloc_free_page (entry->p_addr);
+    clear_entry (entry);
+  }
+
+  lock_release (&ft_lock);
+
+  return;
+}
+
+/**
+ * Purpose:
+ *  Adds a sharer to a frame, must be called with `ft_lock` held
+ *    * a private frame becomes shared, with `spte` as its first sharer
+ *
+ * Args:
+ *  entry {ft_entry*} Frame table entry
+ *  spte {spt_entry*} Supplemental page table entry now mapping the frame
+ *
+ * Returns:
+ *  None
+ */
+static void
+share_add (struct ft_entry *entry, struct spt_entry *spte)
+{
+  if (!entry->shared)
+  {
+    list_init (&entry->sharers);
+    entry->shared = true;
+    entry->ref_cnt = 0;
+  }
+
+  list_push_back (&entry->sharers, &spte->share_elem);
+  entry->ref_cnt++;
+  spte->shared = true;
+}
+
+/**
+ * Purpose:
+ *  Unmaps one sharer of a shared frame, must be called with `ft_lock` held
+ *    * the frame stops being shared, and leaves the text cache, with its
+ *      last sharer, but stays allocated for the caller to free or reuse
+ *
+ * Args:
+ *  entry {ft_entry*} Frame table entry of the shared frame
+ *  spte {spt_entry*} Supplemental page table entry of the sharer
+ *
+ * Returns:
+ *  {bool} True if `spte` was the last sharer
+ */
+static bool
+share_drop (struct ft_entry *entry, struct spt_entry *spte)
+{
+  list_remove (&spte->share_elem);
+  entry->ref_cnt--;
+  spte->shared = false;
+  spte->loaded = false;
+  spte->p_addr = NULL;
+  pagedir_clear_page (spte->owner->pagedir, spte->v_addr);
+
+  if (list_empty (&entry->sharers))
+  {
+    if (entry->inode != NULL)
+    {
+      hash_delete (&share_table, &entry->share_elem);
+      entry->inode = NULL;
+    }
+    entry->shared = false;
+    return true;
+  }
+
+  if (entry->spte == spte)
+  {
+    // frame table entry follows a sharer that is still mapped
+    struct spt_entry *next = list_entry (list_front (&entry->sharers),
+                                         struct spt_entry, share_elem);
+    entry->spte = next;
+    entry->curr = next->owner;
+    entry->v_addr = next->v_addr;
+  }
+
+  return false;
+}
+
+/**
+ * Purpose:
+ *  Hashes a shared text frame by executable inode, offset and bytes
+ *  read from the file
+ *
+ * Args:
+ *  e {hash_elem*} Hash element of the frame table entry
+ *  aux    {void*} Unused
+ *
+ * Returns:
+ *  {unsigned} Hash value
+ */
+static unsigned
+share_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct ft_entry *entry = hash_entry (e, struct ft_entry, share_elem);
+  return hash_bytes (&entry->inode, sizeof entry->inode)
+         ^ hash_int (entry->ofs) ^ hash_int (entry->read_bytes);
+}
+
+/**
+ * Purpose:
+ *  Orders shared text frames by executable inode, then offset, then
+ *  bytes read from the file
+ *
+ * Args:
+ *  a {hash_elem*} Hash element of the first frame table entry
+ *  b {hash_elem*} Hash element of the second frame table entry
+ *  aux    {void*} Unused
+ *
+ * Returns:
+ *  {bool} True if `a` sorts before `b`
+ */
+static bool
+share_less (const struct hash_elem *a, const struct hash_elem *b,
+            void *aux UNUSED)
+{
+  const struct ft_entry *x = hash_entry (a, struct ft_entry, share_elem);
+  const struct ft_entry *y = hash_entry (b, struct ft_entry, share_elem);
+
+  if (x->inode != y->inode)
+  {
+    return x->inode < y->inode;
+  }
+  if (x->ofs != y->ofs)
+  {
+    return x->ofs < y->ofs;
+  }
+  return x->read_bytes < y->read_bytes;
+}
+
+/**
+ * Purpose:
+ *  Makes a loaded page the next pick of the clock, by clearing its
+ *  accessed bit and `used` flag
+ *    * shared frames are left alone, another sharer may still use them
+ *
+ * Args:
+ *  spte {spt_entry*} Supplemental page table entry of the page
+ *
+ * Returns:
+ *  None
+ */
+void
+frame_deactivate (struct spt_entry *spte)
+{
+  lock_acquire (&ft_lock);
+
+  if (spte->loaded && !spte->shared)
+  {
+    pagedir_set_accessed (spte->owner->pagedir, spte->v_addr, false);
+    frame_lookup (spte->p_addr)->used = 0;
+  }
+
+  lock_release (&ft_lock);
+}
+
+/**
+ * Purpose:
+ *  Pins page, first waiting for an eviction of it that is still writing
+ *    * once pinned, the page's frame is never picked by eviction
+ *
+ * Args:
+ *  spte {spt_entry*} Supplemental page table entry to pin
+ *
+ * Returns:
+ *  None
+ */
+void
+frame_pin (struct spt_entry *spte)
+{
+  lock_acquire (&ft_lock);
+
+  if (spte->in_transit)
+  {
+    vmstat_count (thread_current (), VMSTAT_PIN_STALL);
+  }
+  while (spte->in_transit)
+  {
+    cond_wait (&spte->io_done, &ft_lock);
+  }
+  spte->pinned = true;
+
+  lock_release (&ft_lock);
+
+  return;
+}
+
+/**
+ * Purpose:
+ *  Releases frame back to the user pool and clears its frame table entry
+ *
+ * Args:
+ *  p_addr {void*} Physical mem. address returned by `get_frame`
+ *
+ * Returns:
+ *  None
+ */
+void
+free_frame (void *p_addr)
+{
+  lock_acquire (&ft_lock);
+
+  clear_entry (frame_lookup (p_addr));
+  palloc_free_page (p_addr);
+
+  lock_release (&ft_lock);
+
+  return;
+}
+
+/**
+ * Purpose:
+ *  Marks frame table entry free, must be called with `ft_lock` held
+ *
+ * Args:
+ *  entry {ft_entry*} Frame table entry to clear
+ *
+ * Returns:
+ *  None
+ */
+static void
+clear_entry (struct ft_entry *entry)
+{
+  entry->v_addr = NULL;
+  entry->p_addr = NULL;
+  entry->curr = NULL;
+  entry->spte = NULL;
+  entry->used = 0;
+  ft_used--;
+
+  if (entry->repl_list != REPL_NONE)
+  {
+    repl_policy->remove (entry, false);
+  }
+
+  if (entry->merge_queued)
+  {
+    hash_delete (&merge_table, &entry->merge_elem);
+    entry->merge_queued = false;
+  }
+}
+
+/**
+ * Purpose:
+ *  Returns frame table entry of frame to evict
+ *    * frames of processes over their quota go first, then the
+ *      replacement policy picks, see vm/repl.c
+ *    * once swap is full, a victim that would need a slot is passed
+ *      over for a frame that can be dropped or written to its file
+ *    * the victim is taken off the policy's lists
+ *    * must be called with `ft_lock` held
+ *
+ * Args:
+ *  None
+ *
+ * Returns:
+ *  {ft_entry*} Frame table entry of evicted frame, NULL if every frame
+ *              is pinned or needs a swap slot while swap is full
+ */
+struct ft_entry*
+evict_test (void)
+{
+  struct ft_entry *victim = evict_over_quota ();
+  if (victim == NULL)
+  {
+    victim = repl_policy->victim ();
+  }
+
+  if (victim != NULL && evict_needs_swap (victim) && swap_full ())
+  {
+    swap_full_cnt++;
+    victim = evict_clean ();
+  }
+
+  if (victim != NULL)
+  {
+    repl_policy->remove (victim, true);
+  }
+  return victim;
+}
+
+/**
+ * Purpose:
+ *  Checks if evicting a frame would write its page to swap, must be
+ *  called with `ft_lock` held
+ *
+ * Args:
+ *  entry {ft_entry*} Frame table entry of a mapped frame
+ *
+ * Returns:
+ *  {bool} True if the page is dirty and has no file to go back to
+ */
+static bool
+evict_needs_swap (struct ft_entry *entry)
+{
+  struct list_elem *e;
+
+  if (entry->shared)
+  {
+    // shared frames are mapped read-only, their dirty bits are in the
+    // sharers' entries
+    for (e = list_begin (&entry->sharers); e != list_end (&entry->sharers);
+         e = list_next (e))
+    {
+      if (list_entry (e, struct spt_entry, share_elem)->dirty)
+      {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  struct spt_entry *spte = entry->spte;
+  return !spte->is_mmap
+         && (spte->dirty || pagedir_is_dirty (entry->curr->pagedir,
+                                              entry->v_addr));
+}
+
+/**
+ * Purpose:
+ *  Finds an evictable frame whose page can be dropped or written back
+ *  to its file, for when swap is full; must be called with `ft_lock`
+ *  held
+ *
+ * Args:
+ *  None
+ *
+ * Returns:
+ *  {ft_entry*} Frame table entry, NULL if there is none
+ */
+static struct ft_entry *
+evict_clean (void)
+{
+  size_t i;
+
+  for (i = 0; i < ft_size; i++)
+  {
+    struct ft_entry *entry = &f_table[clean_hand];
+    clean_hand = (clean_hand + 1) % ft_size;
+
+    if (frame_evictable (entry) && !evict_needs_swap (entry))
+    {
+      return entry;
+    }
+  }
+
+  return NULL;
+}
+
+/**
+ * Purpose:
+ *  Adds each process's resident frames to its `oom_score`
+ *    * shared frames count for nobody, killing one sharer would not
+ *      free them
+ *
+ * Args:
+ *  None
+ *
+ * Returns:
+ *  None
+ */
+void
+frame_oom_score (void)
+{
+  size_t i;
+
+  lock_acquire (&ft_lock);
+  for (i = 0; i < ft_size; i++)
+  {
+    struct ft_entry *entry = &f_table[i];
+    if (entry->p_addr != NULL && !entry->shared && entry->curr != NULL)
+    {
+      entry->curr->oom_score++;
+    }
+  }
+  lock_release (&ft_lock);
+}
+
+/**
+ * Purpose:
+ *  Frame table entry by index, for the replacement policies' scans
+ *
+ * Args:
+ *  idx {size_t} Frame table index, below `frame_total_cnt ()`
+ *
+ * Returns:
+ *  {ft_entry*} Frame table entry
+ */
+struct ft_entry *
+frame_at (size_t idx)
+{
+  ASSERT (idx < ft_size);
+
+  return &f_table[idx];
+}
+
+/**
+ * Purpose:
+ *  Checks if a frame holds a page and none of its mappers pinned it,
+ *  must be called with `ft_lock` held
+ *
+ * Args:
+ *  entry {ft_entry*} Frame table entry
+ *
+ * Returns:
+ *  {bool} True if the frame may be evicted
+ */
+bool
+frame_evictable (struct ft_entry *entry)
+{
+  struct list_elem *e;
+
+  if (entry->p_addr == NULL || entry->spte->pinned)
+  {
+    return false;
+  }
+
+  if (entry->shared)
+  {
+    for (e = list_begin (&entry->sharers); e != list_end (&entry->sharers);
+         e = list_next (e))
+    {
+      if (list_entry (e, struct spt_entry, share_elem)->pinned)
+      {
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+/**
+ * Purpose:
+ *  Checks if a frame was referenced since the last check, through the
+ *  accessed bit of any mapping or the sampler's `used` flag, must be
+ *  called with `ft_lock` held
+ *    * a shared frame is referenced if any sharer touched it
+ *
+ * Args:
+ *  entry {ft_entry*} Frame table entry
+ *  clear     {bool} True to clear the accessed bits and `used`
+ *
+ * Returns:
+ *  {bool} True if referenced
+ */
+bool
+frame_referenced (struct ft_entry *entry, bool clear)
+{
+  // accessed bits cleared by the sampler are kept in `used`
+  bool accessed = entry->used;
+
+  if (entry->shared)
+  {
+    struct list_elem *e;
+    for (e = list_begin (&entry->sharers); e != list_end (&entry->sharers);
+         e = list_next (e))
+    {
+      struct spt_entry *sharer = list_entry (e, struct spt_entry, share_elem);
+      if (pagedir_is_accessed (sharer->owner->pagedir, sharer->v_addr))
+      {
+        accessed = true;
+        if (!clear)
+        {
+          break;
+        }
+        pagedir_set_accessed (sharer->owner->pagedir, sharer->v_addr, false);
+      }
+    }
+  }
+  else if (pagedir_is_accessed (entry->curr->pagedir, entry->v_addr))
+  {
+    accessed = true;
+    if (clear)
+    {
+      pagedir_set_accessed (entry->curr->pagedir, entry->v_addr, false);
+    }
+  }
+
+  if (clear)
+  {
+    entry->used = 0;
+  }
+  return accessed;
+}
+
+/**
+ * Purpose:
+ *  Checks if evicting a frame needs a write-back, must be called with
+ *  `ft_lock` held
+ *
+ * Args:
+ *  entry {ft_entry*} Frame table entry
+ *
+ * Returns:
+ *  {bool} True if the page differs from its file or zero origin
+ */
+bool
+frame_dirty (struct ft_entry *entry)
+{
+  if (entry->shared)
+  {
+    struct list_elem *e;
+    for (e = list_begin (&entry->sharers); e != list_end (&entry->sharers);
+         e = list_next (e))
+    {
+      if (list_entry (e, struct spt_entry, share_elem)->dirty)
+      {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  return entry->spte->dirty
+         || pagedir_is_dirty (entry->curr->pagedir, entry->v_addr);
+}
+
+/**
+ * Purpose:
+ *  Drops a page about to be freed from the replacement policy's memory
+ *  of evicted pages
+ *    * only an evicted page becomes a ghost, and the owner is freeing
+ *      it, so an unset `repl_ghost` can be trusted without the lock
+ *
+ * Args:
+ *  spte {spt_entry*} Supplemental page table entry of the page
+ *
+ * Returns:
+ *  None
+ */
+void
+frame_forget (struct spt_entry *spte)
+{
+  if (spte->repl_ghost == REPL_NONE)
+  {
+    return;
+  }
+
+  lock_acquire (&ft_lock);
+  repl_forget (spte);
+  lock_release (&ft_lock);
+}
+
+/**
+ * Purpose:
+ *  Picks an unreferenced frame of a process holding more frames than its
+ *  quota, so a process over its working set pays for its own faults
+ *    * shared frames are left to the clock, they count for every sharer
+ *
+ * Args:
+ *  None
+ *
+ * Returns:
+ *  {ft_entry*} Frame table entry to evict, NULL if no process is over
+ *              its quota or none of their frames is idle
+ */
+static struct ft_entry *
+evict_over_quota (void)
+{
+  size_t iter;
+  for (iter = 0; iter < ft_size; iter++)
+  {
+    struct ft_entry *victim = &f_table[quota_hand];
+    quota_hand = (quota_hand + 1) % ft_size;
+
+    if (victim->p_addr == NULL || victim->shared || victim->spte->pinned
+        || !over_quota (victim->curr))
+    {
+      continue;
+    }
+
+    if (!victim->used
+        && !pagedir_is_accessed (victim->curr->pagedir, victim->v_addr))
+    {
+      // charge the eviction now, the next sample recounts it anyway
+      victim->curr->ws_resident--;
+      evict_quota_cnt++;
+      return victim;
+    }
+  }
+  return NULL;
+}
+
+/**
+ * Purpose:
+ *  Checks if a process holds more frames than its quota
+ *
+ * Args:
+ *  t {thread*} Process
+ *
+ * Returns:
+ *  {bool} True if over quota
+ */
+static bool
+over_quota (struct thread *t)
+{
+  return t->ws_resident > t->frame_quota;
+}
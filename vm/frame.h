@@ -1,31 +1,89 @@
+#ifndef VM_FRAME_H
+#define VM_FRAME_H
+
+#include <stddef.h>
+#include <hash.h>
 #include "lib/kernel/list.h"
+#include "filesys/off_t.h"
+
+struct spt_entry;
+struct thread;
+struct inode;
+
+// Free frame watermarks of the page-out daemon, set by `-lowat=N` and
+// `-hiwat=N`: it wakes below the low one and reclaims up to the high one
+extern size_t pageout_low;
+extern size_t pageout_high;
 
-// frame table entry data structure
+// Frames the same-page merging scanner hashes per batch, set by
+// `-merge=N`, 0 leaves the scanner off
+extern size_t merge_scan_pages;
+
+// frame table entry data structure, one per frame of the user pool
 struct ft_entry
 {
   // pointer to user page virtual address
   void *v_addr;
 
-  // pointer to frame memory location
+  // pointer to frame memory location, NULL if frame is free
   void *p_addr;
 
-  // current thread
-  struct thread *curr; 
+  // owning thread, whose pagedir maps `v_addr` to this frame
+  struct thread *curr;
+
+  // supplemental page table entry of the page held in this frame
+  struct spt_entry *spte;
 
-  // status if in use, used for eviction
+  // status if in use, used for eviction: set on allocation and when the
+  // working set sampler finds the page referenced, cleared by the clock
   int used;
 
-  // list element
-  struct list_elem elem;
+  // True if the frame is mapped by the spt entries in `sharers` rather
+  // than by `spte` alone, either from the shared text cache or after fork
+  bool shared;
+
+  // shared frames only: number of spt entries in `sharers`
+  int ref_cnt;
+
+  // shared frames only: every spt entry mapping the frame, read-only
+  struct list sharers;
+
+  // shared text frames only: executable inode, offset and bytes read
+  // from the file of the page, NULL inode if the frame is not in the
+  // shared text cache; two segments may start in the same file page, so
+  // the offset alone does not tell their pages apart
+  struct inode *inode;
+  off_t ofs;
+  uint32_t read_bytes;
+
+  // hash element in the shared text cache
+  struct hash_elem share_elem;
+
+  // shared text frames only: True while the page is being read by the
+  // process that reserved it, see `frame_share_reserve`
+  bool share_busy;
+
+  // content checksum and hash element in the merging scanner's table,
+  // `merge_queued` while the frame is in that table
+  unsigned checksum;
+  struct hash_elem merge_elem;
+  bool merge_queued;
+
+  // list of the replacement policy the frame is on, see vm/repl.h, and
+  // its element there; `repl_fresh` until the reference of the fault that
+  // loaded the page has been consumed
+  int repl_list;
+  struct list_elem repl_elem;
+  bool repl_fresh;
 };
 
 /**
  * Purpose:
  *  Initializes frame table
- * 
+ *
  * Args:
  *  None
- * 
+ *
  * Returns:
  *  None
  */
@@ -34,12 +92,338 @@ void init_frame (void);
 /**
  * Purpose:
  *  Add element to frame table
- * 
+ *
  * Args:
- *  flags    {int} Enum of flags to be passed into `palloc_get_page`
- *  v_addr {void*} Virtual address
- * 
+ *  flags          {int} Enum of flags to be passed into `palloc_get_page`
+ *  spte    {spt_entry*} Supplemental page table entry of the page that
+ *                       will be loaded into the frame
+ *
  * Returns:
  *  {void*} Physical mem. address
- */ 
-void* get_frame (int flags, void* v_addr);
+ */
+void* get_frame (int flags, struct spt_entry *spte);
+
+/**
+ * Purpose:
+ *  Add element to frame table only if a frame is free, never evicts
+ *
+ * Args:
+ *  flags          {int} Enum of flags to be passed into `palloc_get_page`
+ *  spte    {spt_entry*} Supplemental page table entry of the page that
+ *                       will be loaded into the frame
+ *
+ * Returns:
+ *  {void*} Physical mem. address, NULL if no frame is free
+ */
+void* get_free_frame (int flags, struct spt_entry *spte);
+
+/**
+ * Purpose:
+ *  Add a run of physically contiguous frames to frame table, never evicts
+ *
+ * Args:
+ *  flags           {int} Enum of flags to be passed into `palloc_get_multiple`
+ *  sptes   {spt_entry**} Supplemental page table entries, one per frame
+ *  cnt          {size_t} Number of frames
+ *
+ * Returns:
+ *  {void*} Physical mem. address of first frame, NULL if no run of `cnt`
+ *          free frames exists
+ */
+void* get_frames (int flags, struct spt_entry **sptes, size_t cnt);
+
+/**
+ * Purpose:
+ *  Number of user frames not handed out
+ *
+ * Args:
+ *  None
+ *
+ * Returns:
+ *  {size_t} Free frame count
+ */
+size_t frame_free_cnt (void);
+
+/**
+ * Purpose:
+ *  Maps a read-only executable page from the shared text cache
+ *
+ * Args:
+ *  spte {spt_entry*} Supplemental page table entry of the faulting page
+ *
+ * Returns:
+ *  {bool} True if the page was found in the cache and mapped
+ */
+bool frame_share_attach (struct spt_entry *spte);
+
+/**
+ * Purpose:
+ *  Claims a read-only executable page in the shared text cache before
+ *  it is read, so processes faulting on it meanwhile wait for this read
+ *
+ * Args:
+ *  spte {spt_entry*} Supplemental page table entry of the page, pinned
+ *  p_addr   {void*} Frame from `get_frame` the page will be read into
+ *
+ * Returns:
+ *  {bool} False if the page is already in the cache or being read
+ */
+bool frame_share_reserve (struct spt_entry *spte, void *p_addr);
+
+/**
+ * Purpose:
+ *  Ends the read of a page reserved with `frame_share_reserve` that did
+ *  not complete
+ *
+ * Args:
+ *  p_addr {void*} Reserved frame, still allocated
+ *
+ * Returns:
+ *  None
+ */
+void frame_share_cancel (void *p_addr);
+
+/**
+ * Purpose:
+ *  Ends the read of a page reserved with `frame_share_reserve`, making
+ *  the mapped frame shared and waking processes waiting for it
+ *
+ * Args:
+ *  spte {spt_entry*} Supplemental page table entry of the loaded page
+ *
+ * Returns:
+ *  None
+ */
+void frame_share_publish (struct spt_entry *spte);
+
+/**
+ * Purpose:
+ *  Gives a forked child the parent's copy of a page
+ *
+ * Args:
+ *  parent {spt_entry*} Parent's supplemental page table entry
+ *  child  {spt_entry*} Child's entry, a copy of `parent` owned by the
+ *                      current thread
+ *
+ * Returns:
+ *  {bool} False if the child's page table could not be extended
+ */
+bool frame_fork_page (struct spt_entry *parent, struct spt_entry *child);
+
+/**
+ * Purpose:
+ *  Makes a copy-on-write page writable in place if no other process
+ *  maps its frame any more
+ *
+ * Args:
+ *  spte {spt_entry*} Supplemental page table entry of the faulting page
+ *
+ * Returns:
+ *  {bool} True if the page is now writable or was evicted meanwhile,
+ *         false if it must be copied
+ */
+bool frame_cow_claim (struct spt_entry *spte);
+
+/**
+ * Purpose:
+ *  Unmaps one sharer of a shared frame, freeing the frame with the
+ *  last sharer
+ *
+ * Args:
+ *  spte {spt_entry*} Supplemental page table entry of the sharer
+ *
+ * Returns:
+ *  None
+ */
+void frame_share_detach (struct spt_entry *spte);
+
+/**
+ * Purpose:
+ *  Maps an untouched zero-fill page read-only to the shared zero frame
+ *
+ * Args:
+ *  spte {spt_entry*} Supplemental page table entry of the faulting page
+ *
+ * Returns:
+ *  {bool} True if the zero frame was mapped
+ */
+bool frame_zero_map (struct spt_entry *spte);
+
+/**
+ * Purpose:
+ *  Removes the zero frame mapping of a page about to get its own frame
+ *
+ * Args:
+ *  spte {spt_entry*} Supplemental page table entry mapped to the zero
+ *                    frame
+ *
+ * Returns:
+ *  None
+ */
+void frame_zero_unmap (struct spt_entry *spte);
+
+/**
+ * Purpose:
+ *  Makes a loaded page the next pick of the clock, by clearing its
+ *  accessed bit and `used` flag
+ *
+ * Args:
+ *  spte {spt_entry*} Supplemental page table entry of the page
+ *
+ * Returns:
+ *  None
+ */
+void frame_deactivate (struct spt_entry *spte);
+
+/**
+ * Purpose:
+ *  Pins page, first waiting for an eviction of it that is still writing
+ *
+ * Args:
+ *  spte {spt_entry*} Supplemental page table entry to pin
+ *
+ * Returns:
+ *  None
+ */
+void frame_pin (struct spt_entry *spte);
+
+/**
+ * Purpose:
+ *  Releases frame back to the user pool and clears its frame table entry
+ *
+ * Args:
+ *  p_addr {void*} Physical mem. address returned by `get_frame`
+ *
+ * Returns:
+ *  None
+ */
+void free_frame (void *p_addr);
+
+/**
+ * Purpose:
+ *  Find frame table entry by physical frame address in O(1)
+ *
+ * Args:
+ *  p_addr {void*} Physical mem. address of a user pool frame
+ *
+ * Returns:
+ *  {ft_entry*} Frame table entry of the frame
+ */
+struct ft_entry *frame_lookup (void *p_addr);
+
+/**
+ * Purpose:
+ *  Samples and clears the accessed bits of every mapped frame, adding up
+ *  resident and referenced frames in each owner's working set counters
+ *
+ * Args:
+ *  None
+ *
+ * Returns:
+ *  None
+ */
+void frame_sample (void);
+
+/**
+ * Purpose:
+ *  Frame table entry by index, for the replacement policies' scans
+ *
+ * Args:
+ *  idx {size_t} Frame table index, below `frame_total_cnt ()`
+ *
+ * Returns:
+ *  {ft_entry*} Frame table entry
+ */
+struct ft_entry *frame_at (size_t idx);
+
+/**
+ * Purpose:
+ *  Checks if a frame holds a page and none of its mappers pinned it,
+ *  must be called with `ft_lock` held
+ *
+ * Args:
+ *  entry {ft_entry*} Frame table entry
+ *
+ * Returns:
+ *  {bool} True if the frame may be evicted
+ */
+bool frame_evictable (struct ft_entry *entry);
+
+/**
+ * Purpose:
+ *  Checks if a frame was referenced since the last check, through the
+ *  accessed bit of any mapping or the sampler's `used` flag, must be
+ *  called with `ft_lock` held
+ *
+ * Args:
+ *  entry {ft_entry*} Frame table entry
+ *  clear     {bool} True to clear the accessed bits and `used`
+ *
+ * Returns:
+ *  {bool} True if referenced
+ */
+bool frame_referenced (struct ft_entry *entry, bool clear);
+
+/**
+ * Purpose:
+ *  Checks if evicting a frame needs a write-back, must be called with
+ *  `ft_lock` held
+ *
+ * Args:
+ *  entry {ft_entry*} Frame table entry
+ *
+ * Returns:
+ *  {bool} True if the page differs from its file or zero origin
+ */
+bool frame_dirty (struct ft_entry *entry);
+
+/**
+ * Purpose:
+ *  Drops a page about to be freed from the replacement policy's memory
+ *  of evicted pages
+ *
+ * Args:
+ *  spte {spt_entry*} Supplemental page table entry of the page
+ *
+ * Returns:
+ *  None
+ */
+void frame_forget (struct spt_entry *spte);
+
+/**
+ * Purpose:
+ *  Adds each process's resident frames to its `oom_score`
+ *
+ * Args:
+ *  None
+ *
+ * Returns:
+ *  None
+ */
+void frame_oom_score (void);
+
+/**
+ * Purpose:
+ *  Number of frames in the user pool
+ *
+ * Args:
+ *  None
+ *
+ * Returns:
+ *  {size_t} Frame count
+ */
+size_t frame_total_cnt (void);
+
+/**
+ * Purpose:
+ *  Prints eviction statistics at shutdown
+ *
+ * Args:
+ *  None
+ *
+ * Returns:
+ *  None
+ */
+void frame_print_stats (void);
+
+#endif /* vm/frame.h */
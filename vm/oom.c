@@ -0,0 +1,263 @@
+#include <debug.h>
+#include <stdio.h>
+#include "devices/timer.h"
+#include "threads/interrupt.h"
+#include "threads/thread.h"
+#include "userprog/syscall.h"
+#include "vm/frame.h"
+#include "vm/oom.h"
+#include "vm/swap.h"
+
+// Ticks a process waits for a picked victim to exit before retrying
+#define OOM_WAIT 2
+
+// Ticks after which a picked victim that has not started exiting is
+// given up on, it may be blocked or spinning without faults
+#define OOM_EXPIRE (4 * OOM_WAIT)
+
+// process picked by `oom_kill`, and whether an earlier pick is still
+// exiting
+struct oom_pick
+{
+  struct thread *victim;
+  bool pending;
+};
+
+size_t overcommit_pct = 100;
+
+// anonymous pages committed to all processes, and the most ever
+static size_t committed;
+static size_t committed_peak;
+
+// Commitments refused, processes killed and allocations failed
+static long long reject_cnt;
+static long long kill_cnt;
+static long long fail_cnt;
+
+bool oom_charge (size_t page_cnt);
+void oom_uncharge (size_t page_cnt);
+bool oom_kill (void);
+void oom_check (void);
+void oom_print_stats (void);
+
+static void reset_score (struct thread *t, void *aux);
+static void pick_victim (struct thread *t, void *aux);
+
+/**
+ * Purpose:
+ *  Commits anonymous pages to the current process, pages that may have
+ *  to go to swap once written
+ *    * the limit is RAM plus swap scaled by `overcommit_pct`, pages
+ *      shared after fork are counted once per process
+ *
+ * Args:
+ *  page_cnt {size_t} Number of pages
+ *
+ * Returns:
+ *  {bool} False if RAM plus swap could not back them
+ */
+bool
+oom_charge (size_t page_cnt)
+{
+  size_t limit = (frame_total_cnt () + swap_slot_cnt ()) * overcommit_pct
+                 / 100;
+  bool success = true;
+
+  enum intr_level old_level = intr_disable ();
+  if (overcommit_pct != 0 && committed + page_cnt > limit)
+  {
+    reject_cnt++;
+    success = false;
+  }
+  else
+  {
+    committed += page_cnt;
+    thread_current ()->commit_cnt += page_cnt;
+    if (committed > committed_peak)
+    {
+      committed_peak = committed;
+    }
+  }
+  intr_set_level (old_level);
+
+  return success;
+}
+
+/**
+ * Purpose:
+ *  Releases anonymous pages committed to the current process
+ *
+ * Args:
+ *  page_cnt {size_t} Number of pages
+ *
+ * Returns:
+ *  None
+ */
+void
+oom_uncharge (size_t page_cnt)
+{
+  struct thread *cur = thread_current ();
+
+  enum intr_level old_level = intr_disable ();
+  ASSERT (cur->commit_cnt >= page_cnt && committed >= page_cnt);
+  cur->commit_cnt -= page_cnt;
+  committed -= page_cnt;
+  intr_set_level (old_level);
+}
+
+/**
+ * Purpose:
+ *  Last resort when no frame can be freed: marks the process with the
+ *  most resident and swapped pages to exit and waits for it
+ *    * the victim exits at its next page fault or system call, a victim
+ *      picked less than `OOM_EXPIRE` ticks ago is waited for rather
+ *      than a second one picked
+ *    * must be called without `ft_lock` held
+ *
+ * Args:
+ *  None
+ *
+ * Returns:
+ *  {bool} True if the allocation should be retried, false if the
+ *         current process is the one to go
+ */
+bool
+oom_kill (void)
+{
+  struct thread *cur = thread_current ();
+  struct oom_pick pick = { NULL, false };
+
+  if (cur->oom_killed)
+  {
+    return false;
+  }
+
+  enum intr_level old_level = intr_disable ();
+  thread_foreach (reset_score, NULL);
+  intr_set_level (old_level);
+
+  frame_oom_score ();
+  swap_oom_score ();
+
+  old_level = intr_disable ();
+  thread_foreach (pick_victim, &pick);
+  if (!pick.pending && pick.victim != NULL && pick.victim != cur)
+  {
+    pick.victim->oom_killed = true;
+    pick.victim->oom_kill_tick = timer_ticks ();
+    kill_cnt++;
+
+    // load control may hold it suspended
+    if (pick.victim->vm_suspended)
+    {
+      sema_up (&pick.victim->vm_resume);
+    }
+  }
+  intr_set_level (old_level);
+
+  if (!pick.pending && (pick.victim == NULL || pick.victim == cur))
+  {
+    fail_cnt++;
+    return false;
+  }
+
+  timer_sleep (OOM_WAIT);
+  return true;
+}
+
+/**
+ * Purpose:
+ *  Clears a process's badness before it is recounted
+ *
+ * Args:
+ *  t   {thread*} Thread
+ *  aux   {void*} Unused
+ *
+ * Returns:
+ *  None
+ */
+static void
+reset_score (struct thread *t, void *aux UNUSED)
+{
+  t->oom_score = 0;
+}
+
+/**
+ * Purpose:
+ *  Keeps the user process with the highest badness so far
+ *    * processes already in `process_exit` are skipped, they give their
+ *      memory back on their own
+ *    * a process picked before is pending until it starts exiting or
+ *      its pick expires, and is never picked again
+ *
+ * Args:
+ *  t     {thread*} Thread
+ *  aux {oom_pick*} Pick so far
+ *
+ * Returns:
+ *  None
+ */
+static void
+pick_victim (struct thread *t, void *aux)
+{
+  struct oom_pick *pick = aux;
+
+  if (t->pagedir == NULL || t->exiting)
+  {
+    return;
+  }
+  if (t->oom_killed)
+  {
+    if (timer_ticks () - t->oom_kill_tick < OOM_EXPIRE)
+    {
+      pick->pending = true;
+    }
+    return;
+  }
+  if (pick->victim == NULL || t->oom_score > pick->victim->oom_score)
+  {
+    pick->victim = t;
+  }
+}
+
+/**
+ * Purpose:
+ *  Exits the current process if it was picked by `oom_kill`
+ *
+ * Args:
+ *  None
+ *
+ * Returns:
+ *  None
+ */
+void
+oom_check (void)
+{
+  if (thread_current ()->oom_killed)
+  {
+    exit (-1);
+  }
+}
+
+/**
+ * Purpose:
+ *  Prints out-of-memory statistics at shutdown
+ *
+ * Args:
+ *  None
+ *
+ * Returns:
+ *  None
+ */
+void
+oom_print_stats (void)
+{
+  printf ("OOM: %zu pages committed at peak, limit %zu%%, "
+          "%lld commitments refused\n",
+          committed_peak, overcommit_pct, reject_cnt);
+  if (kill_cnt != 0 || fail_cnt != 0)
+  {
+    printf ("OOM: %lld processes killed, %lld allocations failed\n",
+            kill_cnt, fail_cnt);
+  }
+}
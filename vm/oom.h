@@ -0,0 +1,74 @@
+#ifndef VM_OOM_H
+#define VM_OOM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Commit limit in percent of RAM plus swap, set by `-overcommit=PCT`, 0
+// leaves commitments unlimited
+extern size_t overcommit_pct;
+
+/**
+ * Purpose:
+ *  Commits anonymous pages to the current process, pages that may have
+ *  to go to swap once written
+ *
+ * Args:
+ *  page_cnt {size_t} Number of pages
+ *
+ * Returns:
+ *  {bool} False if RAM plus swap could not back them
+ */
+bool oom_charge (size_t page_cnt);
+
+/**
+ * Purpose:
+ *  Releases anonymous pages committed to the current process
+ *
+ * Args:
+ *  page_cnt {size_t} Number of pages
+ *
+ * Returns:
+ *  None
+ */
+void oom_uncharge (size_t page_cnt);
+
+/**
+ * Purpose:
+ *  Last resort when no frame can be freed: marks the process with the
+ *  most resident and swapped pages to exit and waits for it
+ *
+ * Args:
+ *  None
+ *
+ * Returns:
+ *  {bool} True if the allocation should be retried, false if the
+ *         current process is the one to go
+ */
+bool oom_kill (void);
+
+/**
+ * Purpose:
+ *  Exits the current process if it was picked by `oom_kill`
+ *
+ * Args:
+ *  None
+ *
+ * Returns:
+ *  None
+ */
+void oom_check (void);
+
+/**
+ * Purpose:
+ *  Prints out-of-memory statistics at shutdown
+ *
+ * Args:
+ *  None
+ *
+ * Returns:
+ *  None
+ */
+void oom_print_stats (void);
+
+#endif /* vm/oom.h */
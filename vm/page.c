@@ -1,4 +1,5 @@
 #include <string.h>
+#include <round.h>
 
 #include "stdio.h"
 #include "page.h"
@@ -6,12 +7,20 @@
 #include "filesys/file.h"
 #include "filesys/off_t.h"
 #include "lib/kernel/list.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
 #include "threads/malloc.h"
 #include "threads/palloc.h"
+#include "threads/pte.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
+#include "userprog/syscall.h"
 #include "vm/frame.h"
+#include "vm/prepage.h"
+#include "vm/region.h"
+#include "vm/repl.h"
 #include "vm/swap.h"
+#include "vm/vmstat.h"
 
 #include "lib/log.h"
 
@@ -20,13 +29,51 @@ bool create_spt_entry (struct list *spt, struct file *file, off_t ofs, void *upa
                        uint32_t read_bytes, uint32_t zero_bytes, bool writable,
                        bool is_stack);
 bool load_vaddr (struct spt_entry* entry);
+bool create_mmap_entry (struct list *spt, struct file *file, off_t ofs,
+                        void *upage, uint32_t read_bytes, uint32_t zero_bytes);
+void spt_remove_page (struct spt_entry *spte);
+void spt_destroy (void);
+bool spt_discard_page (struct spt_entry *spte);
+bool page_advise (void *uaddr, size_t size, int advice);
+void spt_writeback_page (struct spt_entry *spte);
+bool spt_fork (struct thread *parent, struct file *elf);
+bool cow_fault (struct spt_entry *spte);
 
 struct spt_entry *spt_find_vaddr (struct list *spt, void *v_addr);
-bool in_stack (void *esp, void *fault_addr);
+struct spt_entry *spt_get_page (void *upage);
+bool in_stack (void *esp, void *fault_addr, bool write);
+bool page_pin_range (const void *uaddr, size_t size, bool write);
+void page_unpin_range (const void *uaddr, size_t size);
+void spt_map_large (void *addr, size_t page_cnt);
+
+static void swap_readahead (uint32_t swap_idx, size_t cnt);
+static void drop_page (struct spt_entry *spte);
+static bool fault_around (struct spt_entry *entry);
+static bool is_shareable (struct spt_entry *entry);
+static bool map_large (struct spt_entry **run);
+static bool large_fits (size_t cnt);
+
+size_t fault_around_pages = 8;
+
+bool mmap_large_pages;
+
+// frames pinned by 4 MB pages, they may take at most 1/LARGE_PIN_SHARE
+// of the user pool so one mapping can not pin most of it
+#define LARGE_PIN_SHARE 4
+static size_t large_pinned;
+
+// Number of neighbouring swap slots read in after a swap-in fault, and
+// after one on a page advised MADV_SEQUENTIAL
+#define SWAP_READAHEAD 4
+#define SWAP_READAHEAD_SEQ 16
+
+// Pages behind a MADV_SEQUENTIAL fault that become the clock's next pick
+#define DROP_BEHIND 8
 
 /**
  * Purpose:
  *  Initialize supplemental page table list
+ *    * also starts the current process off with no regions
  * 
  * Args:
  *  None
@@ -41,6 +88,7 @@ spt_init (void)
   struct list *spt = malloc (sizeof( struct list));
   
   list_init(spt);
+  list_init (&thread_current ()->regions);
   
   return spt;
 }
@@ -79,6 +127,9 @@ create_spt_entry (struct list *spt, struct file *file, off_t ofs, void *upage,
     // virtual address
     new_entry->v_addr = upage;
 
+    // owning process
+    new_entry->owner = thread_current ();
+
     // assign file pointer
     new_entry->file_pt = file;
 
@@ -100,6 +151,21 @@ create_spt_entry (struct list *spt, struct file *file, off_t ofs, void *upage,
     // swap index is -1 by default
     new_entry->swap_index = -1;
 
+    // page matches its origin until written
+    new_entry->dirty = false;
+
+    // anonymous or executable page unless created by mmap
+    new_entry->is_mmap = false;
+    new_entry->shared = false;
+    new_entry->zero_page = false;
+    new_entry->large = false;
+    new_entry->advice = MADV_NORMAL;
+    new_entry->repl_ghost = REPL_NONE;
+
+    // no swap-out in flight
+    new_entry->in_transit = false;
+    cond_init (&new_entry->io_done);
+
     if (is_stack)
     {
       new_entry->is_stack = true;
@@ -119,6 +185,7 @@ create_spt_entry (struct list *spt, struct file *file, off_t ofs, void *upage,
     {
       new_entry->pinned = false;
     }
+    new_entry->range_pinned = false;
 
     list_push_back(spt, &new_entry->elem);
 
@@ -130,9 +197,369 @@ create_spt_entry (struct list *spt, struct file *file, off_t ofs, void *upage,
   return result;
 }
 
+/**
+ * Purpose:
+ *  Adds new entry for a page of a memory mapped file
+ *
+ * Args:
+ *  spt           {list*} Supplemental page table list
+ *  file          {file*} File pointer, owned by the mapping
+ *  ofs           {off_t} File offset
+ *  upage         {void*} Virtual address of page
+ *  read_bytes {uint32_t} Number of bytes backed by the file
+ *  zero_bytes {uint32_t} Number of bytes past end of file
+ *
+ * Returns:
+ *  {bool} True if entry successfully created
+ */
+bool
+create_mmap_entry (struct list *spt, struct file *file, off_t ofs,
+                   void *upage, uint32_t read_bytes, uint32_t zero_bytes)
+{
+  if (!create_spt_entry (spt, file, ofs, upage, read_bytes, zero_bytes,
+                         true, false))
+  {
+    return false;
+  }
+
+  // new entry is at the back of the list
+  struct spt_entry *entry = list_entry (list_back (spt), struct spt_entry, elem);
+  entry->is_mmap = true;
+
+  return true;
+}
+
+/**
+ * Purpose:
+ *  Removes page from the current process's address space
+ *    * dirty memory mapped pages are written back to their file
+ *    * frees the frame or swap slot, and the entry itself
+ *
+ * Args:
+ *  spte {spt_entry*} Supplemental page table entry to remove
+ *
+ * Returns:
+ *  None
+ */
+void
+spt_remove_page (struct spt_entry *spte)
+{
+  // wait out an in-flight eviction, then keep the frame from being picked
+  frame_pin (spte);
+
+  drop_page (spte);
+  frame_forget (spte);
+
+  list_remove (&spte->elem);
+  free (spte);
+}
+
+/**
+ * Purpose:
+ *  Releases what holds a pinned page's content, its frame, zero frame
+ *  mapping or swap slot; dirty memory mapped pages are written back first
+ *
+ * Args:
+ *  spte {spt_entry*} Supplemental page table entry, pinned
+ *
+ * Returns:
+ *  None
+ */
+static void
+drop_page (struct spt_entry *spte)
+{
+  struct thread *cur = thread_current ();
+
+  if (spte->loaded)
+  {
+    if (spte->is_mmap
+        && (spte->dirty || pagedir_is_dirty (cur->pagedir, spte->v_addr)))
+    {
+      lock_acquire (&filesys_lock);
+      file_write_at (spte->file_pt, spte->p_addr, spte->read_bytes, spte->ofs);
+      lock_release (&filesys_lock);
+    }
+
+    if (spte->shared)
+    {
+      frame_share_detach (spte);
+    }
+    else
+    {
+      pagedir_clear_page (cur->pagedir, spte->v_addr);
+      free_frame (spte->p_addr);
+    }
+
+    if (spte->large)
+    {
+      // frame leaves the large page budget
+      enum intr_level old_level = intr_disable ();
+      large_pinned--;
+      intr_set_level (old_level);
+      spte->large = false;
+    }
+  }
+  else if (spte->zero_page)
+  {
+    pagedir_clear_page (cur->pagedir, spte->v_addr);
+  }
+  else if (spte->swap_index != -1)
+  {
+    swap_free (spte->swap_index);
+  }
+}
+
+/**
+ * Purpose:
+ *  Drops the content of a page, keeping its entry, so the next access
+ *  sees its file or zero origin again
+ *    * frame and swap slot are freed at once, dirty memory mapped pages
+ *      are written back first as their file is their origin
+ *    * pinned pages, such as 4 MB mapped ones, are left alone
+ *
+ * Args:
+ *  spte {spt_entry*} Supplemental page table entry of the page
+ *
+ * Returns:
+ *  {bool} False if the page is pinned and was left alone
+ */
+bool
+spt_discard_page (struct spt_entry *spte)
+{
+  if (spte->pinned)
+  {
+    return false;
+  }
+
+  frame_pin (spte);
+
+  drop_page (spte);
+
+  spte->loaded = false;
+  spte->p_addr = NULL;
+  spte->zero_page = false;
+  spte->swap_index = -1;
+  spte->dirty = false;
+  spte->pinned = false;
+
+  return true;
+}
+
+/**
+ * Purpose:
+ *  Releases every page of the current process at exit and frees its
+ *  supplemental page table
+ *    * one walk over the table, each page goes through `spt_remove_page`,
+ *      which holds `ft_lock` per page only, so other processes keep
+ *      faulting while a large process exits
+ *    * frames, frame table records, swap slots and zero frame mappings
+ *      are all released, and no frame of the process is left mapped in
+ *      its page directory for `pagedir_destroy` to free twice
+ *
+ * Args:
+ *  None
+ *
+ * Returns:
+ *  None
+ */
+void
+spt_destroy (void)
+{
+  struct thread *cur = thread_current ();
+
+  pagedir_batch_begin ();
+  while (!list_empty (cur->spt))
+  {
+    spt_remove_page (list_entry (list_front (cur->spt), struct spt_entry,
+                                 elem));
+  }
+  pagedir_batch_end ();
+
+  free (cur->spt);
+  cur->spt = NULL;
+  region_destroy ();
+}
+
+/**
+ * Purpose:
+ *  Writes a dirty page of a memory mapped file back to the file
+ *    * the page stays mapped and is clean afterwards
+ *
+ * Args:
+ *  spte {spt_entry*} Supplemental page table entry of the page
+ *
+ * Returns:
+ *  None
+ */
+void
+spt_writeback_page (struct spt_entry *spte)
+{
+  uint32_t *pd = spte->owner->pagedir;
+  bool was_pinned = spte->pinned;
+
+  frame_pin (spte);
+
+  if (spte->loaded && spte->is_mmap
+      && (spte->dirty || pagedir_is_dirty (pd, spte->v_addr)))
+  {
+    lock_acquire (&filesys_lock);
+    file_write_at (spte->file_pt, spte->p_addr, spte->read_bytes, spte->ofs);
+    lock_release (&filesys_lock);
+    pagedir_set_dirty (pd, spte->v_addr, false);
+    spte->dirty = false;
+  }
+
+  spte->pinned = was_pinned;
+}
+
+/**
+ * Purpose:
+ *  Duplicates the parent's address space into the current, newly forked
+ *  process, sharing every loaded frame copy-on-write
+ *    * memory mapped pages are left to the caller, which maps the files
+ *      again with the child's own handles
+ *    * the initial stack page is mapped outside the supplemental page
+ *      table, so it is copied right away
+ *
+ * Args:
+ *  parent {thread*} Forking process, blocked until the fork finishes
+ *  elf      {file*} Child's own handle on the executable
+ *
+ * Returns:
+ *  {bool} True on success
+ */
+bool
+spt_fork (struct thread *parent, struct file *elf)
+{
+  struct thread *cur = thread_current ();
+  struct list_elem *e;
+
+  // pages the parent never touched come from the regions in the child too
+  if (!region_fork (parent, elf))
+  {
+    return false;
+  }
+
+  for (e = list_begin (parent->spt); e != list_end (parent->spt);
+       e = list_next (e))
+  {
+    struct spt_entry *p = list_entry (e, struct spt_entry, elem);
+    if (p->is_mmap)
+    {
+      continue;
+    }
+
+    struct file *file = p->file_pt == parent->elf ? elf : p->file_pt;
+    if (!create_spt_entry (cur->spt, file, p->ofs, p->v_addr, p->read_bytes,
+                           p->zero_bytes, p->writable, p->is_stack))
+    {
+      return false;
+    }
+
+    struct spt_entry *c = list_entry (list_back (cur->spt), struct spt_entry, elem);
+    c->advice = p->advice;
+    if (!frame_fork_page (p, c))
+    {
+      return false;
+    }
+  }
+
+  void *top = PHYS_BASE - PGSIZE;
+  void *kpage = pagedir_get_page (parent->pagedir, top);
+  if (kpage != NULL && spt_find_vaddr (parent->spt, top) == NULL)
+  {
+    if (!create_spt_entry (cur->spt, NULL, 0, top, 0, PGSIZE, true, true))
+    {
+      return false;
+    }
+
+    struct spt_entry *c = list_entry (list_back (cur->spt), struct spt_entry, elem);
+    c->pinned = true;
+    void *frame = get_frame (PAL_USER, c);
+    if (frame == NULL)
+    {
+      c->pinned = false;
+      return false;
+    }
+
+    memcpy (frame, kpage, PGSIZE);
+    c->loaded = true;
+    c->p_addr = frame;
+    c->dirty = true;
+    pagedir_set_page (cur->pagedir, top, frame, true);
+    c->pinned = false;
+  }
+
+  return true;
+}
+
+/**
+ * Purpose:
+ *  Handles a write fault on a copy-on-write page
+ *    * the last process mapping a frame takes it over in place, any
+ *      other copies the page into a private frame
+ *
+ * Args:
+ *  spte {spt_entry*} Supplemental page table entry of the faulting page
+ *
+ * Returns:
+ *  {bool} True if the write can be retried
+ */
+bool
+cow_fault (struct spt_entry *spte)
+{
+  struct thread *cur = thread_current ();
+  bool was_pinned = spte->pinned;
+
+  // first write to a page read from the zero frame, it gets its own frame
+  if (spte->zero_page)
+  {
+    return load_vaddr (spte);
+  }
+
+  // keep the shared frame from being evicted while it is copied
+  frame_pin (spte);
+
+  // copy-on-write is served from memory, claimed or copied
+  vmstat_count (cur, VMSTAT_MINOR);
+
+  if (frame_cow_claim (spte))
+  {
+    spte->pinned = was_pinned;
+    return true;
+  }
+
+  void *shared = spte->p_addr;
+  void *frame = get_frame (PAL_USER, spte);
+  if (frame == NULL)
+  {
+    spte->pinned = was_pinned;
+    return false;
+  }
+  memcpy (frame, shared, PGSIZE);
+
+  // leave the shared frame, freeing it if the other sharers left meanwhile
+  frame_share_detach (spte);
+
+  spte->loaded = true;
+  spte->p_addr = frame;
+  spte->dirty = true;
+  pagedir_set_page (cur->pagedir, spte->v_addr, frame, true);
+
+  spte->pinned = was_pinned;
+
+  return true;
+}
+
 /**
  * Purpose:
  *  Load virtual address on to frame in memory on page fault
+ *    * runs in three phases: a frame is reserved for the pinned page
+ *      under `ft_lock`, the page is read with no lock held, then the
+ *      mapping is installed; so faults of other processes only wait for
+ *      the frame table, never for this page's I/O
+ *    * a text page another process is reading is waited for rather
+ *      than read twice, see `frame_share_reserve`
  * 
  * Args:
  *  entry {spt_entry*} Supplemental page table entry of virtual address
@@ -149,28 +576,85 @@ load_vaddr (struct spt_entry* entry)
 
   struct thread *cur = thread_current ();
 
+  // startup pages are recorded for the next exec of the binary
+  prepage_note (entry);
+
+  // page was read from the zero frame so far, replace that mapping
+  if (entry->zero_page)
+  {
+    frame_zero_unmap (entry);
+  }
+
+  // read-only text may already be in memory for another process
+  if (is_shareable (entry) && frame_share_attach (entry))
+  {
+    vmstat_count (cur, VMSTAT_MINOR);
+    return true;
+  }
+
+  // executable pages are read a window at a time
+  if (entry->swap_index == -1 && !entry->dirty && entry->file_pt != NULL
+      && entry->read_bytes > 0 && fault_around (entry))
+  {
+    vmstat_count (cur, VMSTAT_MAJOR);
+    return true;
+  }
+
+  // pin page so no other process evicts the frame before it is mapped
+  bool was_pinned = entry->pinned;
+  entry->pinned = true;
+
   // physical frame address
-  void* frame = get_frame (PAL_USER, entry->v_addr);
+  void* frame = get_frame (PAL_USER, entry);
 
   if (frame == NULL)
   {
     printf("ERROR: frame allocation failed!\n");
+    entry->pinned = was_pinned;
     return false;
   }
-  else if (entry->swap_index != -1)
+
+  while (is_shareable (entry) && !frame_share_reserve (entry, frame))
+  {
+    // another process started reading the same text page since the
+    // cache was checked, map its copy once the read is done
+    if (frame_share_attach (entry))
+    {
+      free_frame (frame);
+      entry->pinned = was_pinned;
+      vmstat_count (cur, VMSTAT_MINOR);
+      return true;
+    }
+  }
+
+  if (entry->swap_index != -1)
   {
     // printf("load addr. %p from swap %d\n", entry->v_addr, entry->swap_index);
     // page in swap, load into memory
-    entry->pinned = true;
-    swap_get(entry->swap_index, frame);
-    swap_free(entry->swap_index);
+    uint32_t swap_idx = entry->swap_index;
+    uint64_t start = vmstat_clock ();
+    swap_get(swap_idx, frame);
+    swap_free(swap_idx);
     entry->swap_index = -1;
-    entry->pinned = false;
+    vmstat_count (cur, VMSTAT_MAJOR);
+    vmstat_swap_in (cur, start);
+
+    // neighbours in the same cluster are likely to be needed next,
+    // unless the program said it accesses the page at random
+    if (entry->advice == MADV_SEQUENTIAL)
+    {
+      swap_readahead (swap_idx, SWAP_READAHEAD_SEQ);
+    }
+    else if (entry->advice != MADV_RANDOM)
+    {
+      swap_readahead (swap_idx, SWAP_READAHEAD);
+    }
   }
   else if(entry->zero_bytes == PGSIZE)
   {
     // printf("Writing zero page!\n");
     memset (frame, 0, entry->zero_bytes);
+    vmstat_count (cur, VMSTAT_MINOR);
   }
   else
   {
@@ -179,37 +663,72 @@ load_vaddr (struct spt_entry* entry)
     // need to handle swap case
 
     // set position in file to begin reading from
+    lock_acquire (&filesys_lock);
     file_seek (entry->file_pt, entry->ofs);
 
     // read read_bytes (int) from file_pt (file) into frame (as buffer)
     read_ofs = file_read (entry->file_pt, frame, entry->read_bytes);
+    lock_release (&filesys_lock);
 
     if (read_ofs != (int) entry->read_bytes)
     {
       printf("ERROR: number of bytes read from file != found->read_bytes!\n");
+      frame_share_cancel (frame);
+      free_frame (frame);
+      entry->pinned = was_pinned;
       return false;
     }
 
     // set remaining bytes to 0
     memset (frame + read_ofs, 0, entry->zero_bytes);
+    vmstat_count (cur, VMSTAT_MAJOR);
   }
 
-  // set spt entry flags to loaded
-  entry->loaded = true;
-  entry->p_addr = frame;
-
   // printf("file pt: %p, read %d bytes, %d byte ofs, %d read ofs, %d zero bytes\n",
   //         entry->file_pt, entry->read_bytes, entry->ofs, read_ofs, entry->zero_bytes);
 
-  // add pagedir/pte entry
+  // add pagedir/pte entry, the page is only marked loaded once mapped
   if (pagedir_get_page (cur->pagedir, entry->v_addr))
   {
     printf ("ERROR: %p already in page directory!", entry->v_addr);
+    frame_share_cancel (frame);
+    free_frame (frame);
+    entry->pinned = was_pinned;
     return false;
   }
 
-  // create page table entry
-  pagedir_set_page (cur->pagedir, entry->v_addr, frame, entry->writable);
+  // create page table entry, fails if no page table could be allocated
+  if (!pagedir_set_page (cur->pagedir, entry->v_addr, frame, entry->writable))
+  {
+    frame_share_cancel (frame);
+    free_frame (frame);
+    entry->pinned = was_pinned;
+    return false;
+  }
+
+  // set spt entry flags to loaded
+  entry->loaded = true;
+  entry->p_addr = frame;
+
+  if (is_shareable (entry))
+  {
+    frame_share_publish (entry);
+  }
+
+  // page is mapped, eviction may now pick its frame
+  entry->pinned = was_pinned;
+
+  // a sequential scan will not come back to the pages it left behind
+  if (entry->advice == MADV_SEQUENTIAL
+      && (uintptr_t) entry->v_addr >= DROP_BEHIND * PGSIZE)
+  {
+    struct spt_entry *behind = spt_find_vaddr (cur->spt, entry->v_addr
+                                                         - DROP_BEHIND * PGSIZE);
+    if (behind != NULL && behind->advice == MADV_SEQUENTIAL)
+    {
+      frame_deactivate (behind);
+    }
+  }
 
   // set dirty bit to false
   // pagedir_set_dirty (cur->pagedir, entry->v_addr, false);
@@ -220,6 +739,213 @@ load_vaddr (struct spt_entry* entry)
   return true;
 }
 
+/**
+ * Purpose:
+ *  Map a window of not-yet-loaded pages of the same segment following a
+ *  faulting file-backed page, filling them with one contiguous read
+ *    * window is `fault_around_pages`, shrunk to half of the free frames
+ *      so fault-around never forces evictions
+ *
+ * Args:
+ *  entry {spt_entry*} Supplemental page table entry of the faulting page
+ *
+ * Returns:
+ *  {bool} True if the faulting page was loaded, false if the caller
+ *         should load it on its own
+ */
+static bool
+fault_around (struct spt_entry *entry)
+{
+  struct thread *cur = thread_current ();
+  struct spt_entry *run[FAULT_AROUND_MAX];
+  bool was_pinned[FAULT_AROUND_MAX];
+  size_t window = fault_around_pages;
+  size_t free_cnt = frame_free_cnt ();
+  size_t n, i;
+
+  if (entry->advice == MADV_RANDOM)
+  {
+    return false;
+  }
+  if (entry->advice == MADV_SEQUENTIAL)
+  {
+    window = FAULT_AROUND_MAX;
+  }
+  if (window > FAULT_AROUND_MAX)
+  {
+    window = FAULT_AROUND_MAX;
+  }
+  if (window > free_cnt / 2)
+  {
+    window = free_cnt / 2;
+  }
+
+  // collect following pages that continue the same file range
+  run[0] = entry;
+  for (n = 1; n < window; n++)
+  {
+    struct spt_entry *prev = run[n - 1];
+    struct spt_entry *next = spt_get_page (prev->v_addr + PGSIZE);
+
+    if (prev->read_bytes != PGSIZE || next == NULL || next->loaded
+        || next->swap_index != -1 || next->dirty || next->read_bytes == 0
+        || next->file_pt != entry->file_pt || next->writable != entry->writable
+        || next->ofs != prev->ofs + PGSIZE)
+    {
+      break;
+    }
+    run[n] = next;
+  }
+
+  if (n < 2)
+  {
+    return false;
+  }
+
+  for (i = 0; i < n; i++)
+  {
+    was_pinned[i] = run[i]->pinned;
+    run[i]->pinned = true;
+  }
+
+  uint8_t *frames = get_frames (PAL_USER, run, n);
+  if (frames == NULL)
+  {
+    // no contiguous run free, fall back to one page
+    for (i = 0; i < n; i++)
+    {
+      run[i]->pinned = was_pinned[i];
+    }
+    return false;
+  }
+
+  // text pages another process is already reading end the window, so
+  // no page is read twice; if that is the faulting page itself, the
+  // single page path waits for the other read
+  size_t reserved = n;
+  if (is_shareable (entry))
+  {
+    for (reserved = 0; reserved < n; reserved++)
+    {
+      if (!frame_share_reserve (run[reserved], frames + reserved * PGSIZE))
+      {
+        break;
+      }
+    }
+    for (i = reserved; i < n; i++)
+    {
+      free_frame (frames + i * PGSIZE);
+      run[i]->pinned = was_pinned[i];
+    }
+    n = reserved;
+  }
+
+  off_t want = n > 0 ? (off_t) ((n - 1) * PGSIZE + run[n - 1]->read_bytes)
+                     : 0;
+  off_t got = 0;
+  if (n > 0)
+  {
+    lock_acquire (&filesys_lock);
+    got = file_read_at (entry->file_pt, frames, want, entry->ofs);
+    lock_release (&filesys_lock);
+  }
+  if (n == 0 || got != want)
+  {
+    // short read, fall back to one page
+    for (i = 0; i < n; i++)
+    {
+      frame_share_cancel (frames + i * PGSIZE);
+      free_frame (frames + i * PGSIZE);
+      run[i]->pinned = was_pinned[i];
+    }
+    return false;
+  }
+
+  for (i = 0; i < n; i++)
+  {
+    uint8_t *frame = frames + i * PGSIZE;
+    memset (frame + run[i]->read_bytes, 0, run[i]->zero_bytes);
+
+    run[i]->loaded = true;
+    run[i]->p_addr = frame;
+    pagedir_set_page (cur->pagedir, run[i]->v_addr, frame, run[i]->writable);
+    if (is_shareable (run[i]))
+    {
+      frame_share_publish (run[i]);
+    }
+    run[i]->pinned = was_pinned[i];
+  }
+
+  return true;
+}
+
+/**
+ * Purpose:
+ *  Read in pages of the current process that sit in the swap slots
+ *  following a slot just read, as long as frames are free
+ *
+ * Args:
+ *  swap_idx {uint32_t} Swap index of the page just read
+ *  cnt        {size_t} Number of following slots to try
+ *
+ * Returns:
+ *  None
+ */
+static void
+swap_readahead (uint32_t swap_idx, size_t cnt)
+{
+  struct thread *cur = thread_current ();
+  uint32_t next;
+
+  for (next = swap_idx + 1; next <= swap_idx + cnt; next++)
+  {
+    struct spt_entry *spte = swap_lookup (next, cur);
+    if (spte == NULL)
+    {
+      // end of this process's run of slots
+      return;
+    }
+
+    spte->pinned = true;
+    void *frame = get_free_frame (PAL_USER, spte);
+    if (frame == NULL)
+    {
+      // no free frame, don't evict for a page nobody asked for yet
+      spte->pinned = false;
+      return;
+    }
+
+    uint64_t start = vmstat_clock ();
+    swap_get (next, frame);
+    swap_free (next);
+    spte->swap_index = -1;
+    vmstat_swap_in (cur, start);
+
+    spte->loaded = true;
+    spte->p_addr = frame;
+    pagedir_set_page (cur->pagedir, spte->v_addr, frame, spte->writable);
+    spte->pinned = false;
+  }
+}
+
+/**
+ * Purpose:
+ *  Checks if page may live in the shared text cache, i.e. it is read-only
+ *  executable content that no process can ever change
+ *
+ * Args:
+ *  entry {spt_entry*} Supplemental page table entry
+ *
+ * Returns:
+ *  {bool} True if the page can be shared between processes
+ */
+static bool
+is_shareable (struct spt_entry *entry)
+{
+  return entry->file_pt != NULL && !entry->writable && !entry->is_mmap
+         && entry->read_bytes > 0 && entry->swap_index == -1;
+}
+
 /**
  * Purpose:
  *  Find supplemental page table entry by virtual address
@@ -248,6 +974,36 @@ spt_find_vaddr (struct list *spt, void *v_addr)
   return NULL;
 }
 
+/**
+ * Purpose:
+ *  Find supplemental page table entry of a page of the current process,
+ *  creating it from the page's region on first touch
+ *
+ * Args:
+ *  upage {void*} Page aligned user virtual address
+ *
+ * Returns:
+ *  {spt_entry*} Entry of the page, NULL if the page is in no region or
+ *               memory ran out
+ */
+struct spt_entry *
+spt_get_page (void *upage)
+{
+  struct thread *cur = thread_current ();
+  struct spt_entry *spte = spt_find_vaddr (cur->spt, upage);
+
+  if (spte == NULL)
+  {
+    struct region *r = region_find (cur, upage);
+    if (r != NULL)
+    {
+      spte = region_page (r, upage);
+    }
+  }
+
+  return spte;
+}
+
 /**
  * Purpose:
  *  Load stack page into memory if valid stack address
@@ -260,7 +1016,7 @@ spt_find_vaddr (struct list *spt, void *v_addr)
  *  {bool} True if page can exist in stack
  */
 bool
-in_stack (void *esp, void *fault_addr)
+in_stack (void *esp, void *fault_addr, bool write)
 {
   // 8 Mb of stack space
   const uint32_t STACK_MAX = 8388608;
@@ -287,11 +1043,14 @@ in_stack (void *esp, void *fault_addr)
     return false;
   }
 
-  // create spt entry for stack page, all zero bytes
-  create_spt_entry (cur->spt, NULL, 0, page, 0, 4096, 1, true);
+  // grow the stack region and create the entry of the page, all zero bytes
+  if (!region_grow_stack (page))
+  {
+    return false;
+  }
+  vmstat_count (cur, VMSTAT_STACK);
 
-  struct spt_entry* found = spt_find_vaddr (cur->spt, page);
-  found->pinned = true;
+  struct spt_entry* found = spt_get_page (page);
 
   if (found == NULL)
   {
@@ -303,6 +1062,13 @@ in_stack (void *esp, void *fault_addr)
   {
     // spt entry found for v. addr
 
+    if (!write && frame_zero_map (found))
+    {
+      // read of a new stack page, nothing to allocate yet
+
+      return true;
+    }
+
     if (load_vaddr (found))
     {
       // load successful
@@ -320,3 +1086,363 @@ in_stack (void *esp, void *fault_addr)
   return true;
 }
 
+/**
+ * Purpose:
+ *  Validates a user buffer of the current process, faults its pages in
+ *  and pins them, one lookup per page
+ *    * a missing page below the saved user stack pointer grows the stack,
+ *      as a fault on it would
+ *    * a write to a copy-on-write page is resolved here, the kernel must
+ *      not fault on a pinned frame that is still shared
+ *    * the initial stack page is mapped outside the supplemental page
+ *      table and never evicted, so it is taken as is
+ *
+ * Args:
+ *  uaddr {void*} Start of the buffer
+ *  size {size_t} Buffer length in bytes
+ *  write  {bool} True if the kernel will write to the buffer
+ *
+ * Returns:
+ *  {bool} True if the whole buffer is pinned, false if part of it is not
+ *         mapped or not writable, nothing stays pinned then
+ */
+bool
+page_pin_range (const void *uaddr, size_t size, bool write)
+{
+  struct thread *cur = thread_current ();
+  uint8_t *start = pg_round_down (uaddr);
+  uint8_t *end;
+  uint8_t *page;
+
+  if (size == 0)
+  {
+    return true;
+  }
+
+  end = (uint8_t *) uaddr + size - 1;
+  if (end < (uint8_t *) uaddr || !is_user_vaddr (end))
+  {
+    return false;
+  }
+
+  for (page = start; page <= end; page += PGSIZE)
+  {
+    struct spt_entry *spte = spt_get_page (page);
+
+    if (spte == NULL)
+    {
+      void *addr = page == start ? (void *) uaddr : page;
+      if (pagedir_get_page (cur->pagedir, page) != NULL)
+      {
+        continue;
+      }
+      if (!in_stack (cur->esp, addr, write)
+          || (spte = spt_find_vaddr (cur->spt, page)) == NULL)
+      {
+        break;
+      }
+    }
+
+    if (write && !spte->writable)
+    {
+      break;
+    }
+
+    if (!spte->pinned)
+    {
+      frame_pin (spte);
+      spte->range_pinned = true;
+    }
+
+    // the kernel may read a zero-fill page through the zero frame
+    if (!spte->loaded
+        && !(!write && (spte->zero_page || frame_zero_map (spte)))
+        && !load_vaddr (spte))
+    {
+      break;
+    }
+
+    if (write && spte->shared && !cow_fault (spte))
+    {
+      break;
+    }
+  }
+
+  if (page <= end)
+  {
+    // undo the pages up to and including the bad one
+    page_unpin_range (start, page - start + 1);
+    return false;
+  }
+
+  return true;
+}
+
+/**
+ * Purpose:
+ *  Unpins a buffer pinned by `page_pin_range`
+ *    * pages pinned for another reason before stay pinned
+ *
+ * Args:
+ *  uaddr {void*} Start of the buffer
+ *  size {size_t} Buffer length in bytes
+ *
+ * Returns:
+ *  None
+ */
+void
+page_unpin_range (const void *uaddr, size_t size)
+{
+  struct thread *cur = thread_current ();
+  uint8_t *page;
+
+  if (size == 0)
+  {
+    return;
+  }
+
+  for (page = pg_round_down (uaddr); page <= (uint8_t *) uaddr + size - 1;
+       page += PGSIZE)
+  {
+    struct spt_entry *spte = spt_find_vaddr (cur->spt, page);
+    if (spte != NULL && spte->range_pinned)
+    {
+      spte->range_pinned = false;
+      spte->pinned = false;
+    }
+  }
+}
+
+/**
+ * Purpose:
+ *  Applies madvise advice to a page aligned range of the current process
+ *    * MADV_NORMAL, MADV_RANDOM and MADV_SEQUENTIAL are kept per page and
+ *      per region, for pages not touched yet, and steer fault-around,
+ *      swap readahead and reclaim behind a scan
+ *    * MADV_WILLNEED reads file and swapped pages in right away, with
+ *      their usual readahead, but only while frames are free above the
+ *      page-out low watermark; prefetch never forces an eviction
+ *    * MADV_DONTNEED discards pages with `spt_discard_page`
+ *    * pages of the range without an entry are skipped, except file
+ *      pages of a region for MADV_WILLNEED
+ *
+ * Args:
+ *  uaddr  {void*} Start of range, page aligned
+ *  size  {size_t} Length of range in bytes
+ *  advice   {int} One of the MADV_* values
+ *
+ * Returns:
+ *  {bool} False if the range or the advice is invalid
+ */
+bool
+page_advise (void *uaddr, size_t size, int advice)
+{
+  struct thread *cur = thread_current ();
+  uint8_t *start = uaddr;
+  uint8_t *page;
+
+  if (pg_ofs (uaddr) != 0 || !is_user_vaddr (uaddr)
+      || size > (size_t) ((uint8_t *) PHYS_BASE - start)
+      || advice < MADV_NORMAL || advice > MADV_DONTNEED)
+  {
+    return false;
+  }
+
+  pagedir_batch_begin ();
+  for (page = start; page < start + size; page += PGSIZE)
+  {
+    struct spt_entry *spte = spt_find_vaddr (cur->spt, page);
+    if (spte == NULL && advice == MADV_WILLNEED)
+    {
+      // untouched zero-fill pages need no entry ahead of their first touch
+      struct region *r = region_find (cur, page);
+      if (r != NULL && r->file != NULL
+          && (uint32_t) (page - r->start) < r->read_bytes)
+      {
+        spte = region_page (r, page);
+      }
+    }
+    if (spte == NULL)
+    {
+      continue;
+    }
+
+    if (advice == MADV_WILLNEED)
+    {
+      if (frame_free_cnt () <= pageout_low)
+      {
+        break;
+      }
+
+      // zero-fill pages cost no I/O, they are left to their first touch
+      if (!spte->loaded && !spte->pinned
+          && (spte->swap_index != -1
+              || (spte->file_pt != NULL && spte->read_bytes > 0))
+          && !load_vaddr (spte))
+      {
+        break;
+      }
+    }
+    else if (advice == MADV_DONTNEED)
+    {
+      spt_discard_page (spte);
+    }
+    else
+    {
+      spte->advice = advice;
+    }
+  }
+  pagedir_batch_end ();
+
+  if (advice != MADV_WILLNEED && advice != MADV_DONTNEED)
+  {
+    region_advise (uaddr, size, advice);
+  }
+
+  return true;
+}
+
+/**
+ * Purpose:
+ *  Backs the 4 MB aligned parts of a new memory mapping of the current
+ *  process with 4 MB pages, if `mmap_large_pages` is set
+ *    * a part that finds no 4 MB aligned run of free frames keeps its
+ *      lazy 4 kB pages
+ *    * so does a part that would take 4 MB pages past their share of
+ *      the user pool, or leave fewer than `pageout_high` frames free;
+ *      4 MB pages are read eagerly and stay pinned, so they must not
+ *      starve other processes into eviction failure
+ *
+ * Args:
+ *  addr    {void*} Start of the mapping
+ *  page_cnt {size_t} Number of pages in the mapping
+ *
+ * Returns:
+ *  None
+ */
+void
+spt_map_large (void *addr, size_t page_cnt)
+{
+  struct thread *cur = thread_current ();
+  size_t large_cnt = PTSPAN / PGSIZE;
+  uint8_t *end = (uint8_t *) addr + page_cnt * PGSIZE;
+  uint8_t *upage;
+
+  if (!mmap_large_pages || !pse_enabled)
+  {
+    return;
+  }
+
+  struct spt_entry **run = malloc (large_cnt * sizeof *run);
+  if (run == NULL)
+  {
+    return;
+  }
+
+  for (upage = (uint8_t *) ROUND_UP ((uintptr_t) addr, PTSPAN);
+       upage + PTSPAN <= end; upage += PTSPAN)
+  {
+    struct region *r = region_find (cur, upage);
+    size_t i;
+
+    // the mapping is new, none of its pages has an entry yet
+    for (i = 0; i < large_cnt; i++)
+    {
+      if (r == NULL || upage + i * PGSIZE >= r->end
+          || (run[i] = region_page (r, upage + i * PGSIZE)) == NULL)
+      {
+        break;
+      }
+    }
+
+    if (i == large_cnt && large_fits (large_cnt))
+    {
+      map_large (run);
+    }
+  }
+
+  free (run);
+}
+
+/**
+ * Purpose:
+ *  Checks if a 4 MB page may pin more frames
+ *
+ * Args:
+ *  cnt {size_t} Frames of the 4 MB page
+ *
+ * Returns:
+ *  {bool} True if the pinned frames stay within their share of the
+ *         user pool and enough frames stay free for 4 kB faults
+ */
+static bool
+large_fits (size_t cnt)
+{
+  return large_pinned + cnt <= frame_total_cnt () / LARGE_PIN_SHARE
+         && frame_free_cnt () >= cnt + pageout_high;
+}
+
+/**
+ * Purpose:
+ *  Reads 4 MB of a memory mapped file into a 4 MB aligned run of frames
+ *  and maps it with a single 4 MB page
+ *    * the frames stay pinned, eviction and the working set sampler only
+ *      handle 4 kB mappings; unmapping frees them a frame at a time
+ *    * there is one dirty bit for the whole 4 MB, so a single store
+ *      makes munmap and exit write all of it back
+ *
+ * Args:
+ *  run {spt_entry**} Entries of the 4 MB, in address order
+ *
+ * Returns:
+ *  {bool} True if mapped
+ */
+static bool
+map_large (struct spt_entry **run)
+{
+  struct thread *cur = thread_current ();
+  size_t large_cnt = PTSPAN / PGSIZE;
+  off_t read_bytes = 0;
+  size_t i;
+
+  for (i = 0; i < large_cnt; i++)
+  {
+    run[i]->pinned = true;
+    read_bytes += run[i]->read_bytes;
+  }
+
+  uint8_t *kpage = get_frames (PAL_USER | PAL_LARGE, run, large_cnt);
+  off_t got = 0;
+  if (kpage != NULL)
+  {
+    lock_acquire (&filesys_lock);
+    got = file_read_at (run[0]->file_pt, kpage, read_bytes, run[0]->ofs);
+    lock_release (&filesys_lock);
+  }
+  if (kpage != NULL && got == read_bytes
+      && pagedir_set_large (cur->pagedir, run[0]->v_addr, kpage, true))
+  {
+    memset (kpage + read_bytes, 0, PTSPAN - read_bytes);
+    for (i = 0; i < large_cnt; i++)
+    {
+      run[i]->loaded = true;
+      run[i]->p_addr = kpage + i * PGSIZE;
+      run[i]->large = true;
+    }
+
+    enum intr_level old_level = intr_disable ();
+    large_pinned += large_cnt;
+    intr_set_level (old_level);
+    return true;
+  }
+
+  for (i = 0; i < large_cnt; i++)
+  {
+    if (kpage != NULL)
+    {
+      free_frame (kpage + i * PGSIZE);
+    }
+    run[i]->pinned = false;
+  }
+  return false;
+}
@@ -1,8 +1,22 @@
+#ifndef VM_PAGE_H
+#define VM_PAGE_H
+
+#include <madvise.h>
 #include "lib/kernel/list.h"
 #include "filesys/file.h"
 #include "filesys/off_t.h"
+#include "threads/synch.h"
 #include "userprog/pagedir.h"
 
+// Largest fault-around window, in pages
+#define FAULT_AROUND_MAX 16
+
+// Pages mapped per fault on executable segments, set by `-fa=N`
+extern size_t fault_around_pages;
+
+// Back 4 MB aligned parts of memory mappings with 4 MB pages, set by `-lp`
+extern bool mmap_large_pages;
+
 struct spt_entry{
 
   //hash element
@@ -11,6 +25,9 @@ struct spt_entry{
   // key
   void * v_addr;
 
+  // process whose address space holds the page
+  struct thread *owner;
+
   // physical frame address
   void * p_addr;
 
@@ -38,8 +55,48 @@ struct spt_entry{
   // True if stack page
   bool is_stack;
 
+  // True if page of a memory mapped file, written back instead of swapped
+  bool is_mmap;
+
+  // True while mapped from a frame of the shared text cache
+  bool shared;
+
+  // True while an untouched zero-fill page is mapped read-only to the
+  // global zero frame, `loaded` stays false until the first write
+  bool zero_page;
+
+  // list element in the sharers list of the shared frame
+  struct list_elem share_elem;
+
+  // True once page content differs from its file or zero origin, so
+  // eviction must keep it in swap
+  bool dirty;
+
   // Pins page so it can not be overwritten
   bool pinned;
+
+  // True if `pinned` was set by `page_pin_range` and is cleared by
+  // `page_unpin_range`
+  bool range_pinned;
+
+  // True if the page is part of a 4 MB page mapped by `spt_map_large`,
+  // its frame is pinned and counted in the large page budget
+  bool large;
+
+  // True while an evicted copy of the page is being written to swap
+  bool in_transit;
+
+  // Signalled under `ft_lock` when `in_transit` clears
+  struct condition io_done;
+
+  // Access pattern given by madvise, MADV_NORMAL, MADV_RANDOM or
+  // MADV_SEQUENTIAL
+  int advice;
+
+  // ghost list of the replacement policy remembering the evicted page,
+  // see vm/repl.h, and its element there
+  int repl_ghost;
+  struct list_elem ghost_elem;
 };
 
 
@@ -78,6 +135,116 @@ create_spt_entry (struct list *spt, struct file *file, off_t ofs, void *upage,
                   uint32_t read_bytes, uint32_t zero_bytes, bool writable,
                   bool is_stack);
 
+/**
+ * Purpose:
+ *  Adds new entry for a page of a memory mapped file
+ *
+ * Args:
+ *  spt           {list*} Supplemental page table list
+ *  file          {file*} File pointer, owned by the mapping
+ *  ofs           {off_t} File offset
+ *  upage         {void*} Virtual address of page
+ *  read_bytes {uint32_t} Number of bytes backed by the file
+ *  zero_bytes {uint32_t} Number of bytes past end of file
+ *
+ * Returns:
+ *  {bool} True if entry successfully created
+ */
+bool create_mmap_entry (struct list *spt, struct file *file, off_t ofs,
+                        void *upage, uint32_t read_bytes, uint32_t zero_bytes);
+
+/**
+ * Purpose:
+ *  Removes page from the current process's address space
+ *    * dirty memory mapped pages are written back to their file
+ *    * frees the frame or swap slot, and the entry itself
+ *
+ * Args:
+ *  spte {spt_entry*} Supplemental page table entry to remove
+ *
+ * Returns:
+ *  None
+ */
+void spt_remove_page (struct spt_entry *spte);
+
+/**
+ * Purpose:
+ *  Releases every page of the current process at exit and frees its
+ *  supplemental page table
+ *
+ * Args:
+ *  None
+ *
+ * Returns:
+ *  None
+ */
+void spt_destroy (void);
+
+/**
+ * Purpose:
+ *  Drops the content of a page, keeping its entry, so the next access
+ *  sees its file or zero origin again
+ *
+ * Args:
+ *  spte {spt_entry*} Supplemental page table entry of the page
+ *
+ * Returns:
+ *  {bool} False if the page is pinned and was left alone
+ */
+bool spt_discard_page (struct spt_entry *spte);
+
+/**
+ * Purpose:
+ *  Applies madvise advice to a page aligned range of the current process
+ *
+ * Args:
+ *  uaddr  {void*} Start of range, page aligned
+ *  size  {size_t} Length of range in bytes
+ *  advice   {int} One of the MADV_* values
+ *
+ * Returns:
+ *  {bool} False if the range or the advice is invalid
+ */
+bool page_advise (void *uaddr, size_t size, int advice);
+
+/**
+ * Purpose:
+ *  Writes a dirty page of a memory mapped file back to the file
+ *
+ * Args:
+ *  spte {spt_entry*} Supplemental page table entry of the page
+ *
+ * Returns:
+ *  None
+ */
+void spt_writeback_page (struct spt_entry *spte);
+
+/**
+ * Purpose:
+ *  Duplicates the parent's address space into the current, newly forked
+ *  process, sharing every loaded frame copy-on-write
+ *
+ * Args:
+ *  parent {thread*} Forking process, blocked until the fork finishes
+ *  elf      {file*} Child's own handle on the executable
+ *
+ * Returns:
+ *  {bool} True on success
+ */
+bool spt_fork (struct thread *parent, struct file *elf);
+
+/**
+ * Purpose:
+ *  Handles a write fault on a copy-on-write page
+ *
+ * Args:
+ *  spte {spt_entry*} Supplemental page table entry of the faulting page
+ *
+ * Returns:
+ *  {bool} True if the write can be retried
+ */
+bool cow_fault (struct spt_entry *spte);
+
 /**
  * Purpose:
  *  Load virtual address on to frame in memory on page fault
@@ -105,6 +272,20 @@ bool load_vaddr (struct spt_entry *entry);
  */ 
 struct spt_entry *spt_find_vaddr (struct list *spt, void *v_addr);
 
+/**
+ * Purpose:
+ *  Find supplemental page table entry of a page of the current process,
+ *  creating it from the page's region on first touch
+ *
+ * Args:
+ *  upage {void*} Page aligned user virtual address
+ *
+ * Returns:
+ *  {spt_entry*} Entry of the page, NULL if the page is in no region or
+ *               memory ran out
+ */
+struct spt_entry *spt_get_page (void *upage);
+
 /**
  * Purpose:
  *  Load stack page into memory if valid stack address
@@ -112,8 +293,54 @@ struct spt_entry *spt_find_vaddr (struct list *spt, void *v_addr);
  * Args:
  *  esp        {void*} Stack pointer
  *  fault_addr {void*} Fault address
+ *  write       {bool} True if the access was a write
  * 
  * Returns:
  *  {bool} True if page can exist in stack
  */
-bool in_stack (void * esp, void *fault_addr);
\ No newline at end of file
+bool in_stack (void * esp, void *fault_addr, bool write);
+
+/**
+ * Purpose:
+ *  Validates a user buffer of the current process, faults its pages in
+ *  and pins them, one lookup per page
+ *
+ * Args:
+ *  uaddr {void*} Start of the buffer
+ *  size {size_t} Buffer length in bytes
+ *  write  {bool} True if the kernel will write to the buffer
+ *
+ * Returns:
+ *  {bool} True if the whole buffer is pinned, false if part of it is not
+ *         mapped or not writable, nothing stays pinned then
+ */
+bool page_pin_range (const void *uaddr, size_t size, bool write);
+
+/**
+ * Purpose:
+ *  Unpins a buffer pinned by `page_pin_range`
+ *
+ * Args:
+ *  uaddr {void*} Start of the buffer
+ *  size {size_t} Buffer length in bytes
+ *
+ * Returns:
+ *  None
+ */
+void page_unpin_range (const void *uaddr, size_t size);
+
+/**
+ * Purpose:
+ *  Backs the 4 MB aligned parts of a new memory mapping of the current
+ *  process with 4 MB pages, if `mmap_large_pages` is set
+ *
+ * Args:
+ *  addr    {void*} Start of the mapping
+ *  page_cnt {size_t} Number of pages in the mapping
+ *
+ * Returns:
+ *  None
+ */
+void spt_map_large (void *addr, size_t page_cnt);
+
+#endif /* vm/page.h */
@@ -0,0 +1,398 @@
+#include <debug.h>
+#include <list.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/block.h"
+#include "devices/timer.h"
+#include "filesys/file.h"
+#include "filesys/inode.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "vm/frame.h"
+#include "vm/page.h"
+#include "vm/prepage.h"
+#include "vm/vmstat.h"
+
+// Executable pages recorded per binary
+#define PREPAGE_PAGES 64
+
+// Binaries with a recorded set, the least recently executed one is
+// dropped for a new one
+#define PREPAGE_SETS 16
+
+// startup pages of one executable, in ascending address order once
+// recorded
+struct prepage_set
+{
+  // inode sector of the executable
+  block_sector_t inumber;
+
+  // number of pages and their user virtual addresses
+  size_t cnt;
+  void *pages[PREPAGE_PAGES];
+
+  // element in `sets`
+  struct list_elem elem;
+};
+
+size_t prepage_ms = 100;
+
+// recorded sets, most recently executed first, and their number
+static struct list sets;
+static size_t set_cnt;
+
+// protects `sets` and the counters below, never held across I/O
+static struct lock prepage_lock;
+
+// Starts without a record and the page loads inside their window
+static long long cold_cnt;
+static long long cold_loads;
+
+// Starts with a prefetched record and the page loads inside their window
+static long long warm_cnt;
+static long long warm_loads;
+
+// Sets recorded and dropped by a write, pages prefetched and cycles spent
+static long long record_cnt;
+static long long invalidate_cnt;
+static long long prefetch_cnt;
+static uint64_t prefetch_cycles;
+
+void prepage_init (void);
+void prepage_exec (void);
+void prepage_note (struct spt_entry *spte);
+void prepage_exit (void);
+void prepage_invalidate (struct inode *inode);
+void prepage_print_stats (void);
+
+static struct prepage_set *find_set (block_sector_t inumber);
+static void prepage_finish (struct thread *t);
+
+/**
+ * Purpose:
+ *  Initializes the table of recorded startup working sets
+ *
+ * Args:
+ *  None
+ *
+ * Returns:
+ *  None
+ */
+void
+prepage_init (void)
+{
+  list_init (&sets);
+  lock_init (&prepage_lock);
+}
+
+/**
+ * Purpose:
+ *  Finds the recorded set of an executable, with `prepage_lock` held
+ *
+ * Args:
+ *  inumber {block_sector_t} Inode sector of the executable
+ *
+ * Returns:
+ *  {prepage_set*} Recorded set, NULL if there is none
+ */
+static struct prepage_set *
+find_set (block_sector_t inumber)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&sets); e != list_end (&sets); e = list_next (e))
+  {
+    struct prepage_set *set = list_entry (e, struct prepage_set, elem);
+    if (set->inumber == inumber)
+    {
+      return set;
+    }
+  }
+
+  return NULL;
+}
+
+/**
+ * Purpose:
+ *  Starts a freshly loaded process: prefetches the pages recorded for
+ *  its executable, or starts recording them if there is no record
+ *    * called right after `load()`, the pages are read with
+ *      MADV_WILLNEED so runs of them come in with one fault-around read
+ *      and prefetching stops at the page-out daemon's low watermark
+ *    * the startup window opens once prefetching is done
+ *
+ * Args:
+ *  None
+ *
+ * Returns:
+ *  None
+ */
+void
+prepage_exec (void)
+{
+  struct thread *cur = thread_current ();
+  void *pages[PREPAGE_PAGES];
+  size_t cnt = 0;
+  size_t i;
+
+  if (prepage_ms == 0 || cur->elf == NULL)
+  {
+    return;
+  }
+
+  block_sector_t inumber = inode_get_inumber (file_get_inode (cur->elf));
+
+  // copy the record out, the lock is not held while pages are read
+  lock_acquire (&prepage_lock);
+  struct prepage_set *set = find_set (inumber);
+  if (set != NULL)
+  {
+    list_remove (&set->elem);
+    list_push_front (&sets, &set->elem);
+    cnt = set->cnt;
+    memcpy (pages, set->pages, cnt * sizeof *pages);
+  }
+  lock_release (&prepage_lock);
+
+  if (set == NULL)
+  {
+    // first run of the binary, or its record was dropped
+    cur->prepage_set = malloc (sizeof *cur->prepage_set);
+    if (cur->prepage_set == NULL)
+    {
+      return;
+    }
+    cur->prepage_set->inumber = inumber;
+    cur->prepage_set->cnt = 0;
+  }
+  else
+  {
+    uint64_t start = vmstat_clock ();
+    size_t loaded = 0;
+
+    for (i = 0; i < cnt && frame_free_cnt () > pageout_low; i++)
+    {
+      page_advise (pages[i], PGSIZE, MADV_WILLNEED);
+
+      struct spt_entry *spte = spt_find_vaddr (cur->spt, pages[i]);
+      if (spte != NULL && spte->loaded)
+      {
+        loaded++;
+      }
+    }
+
+    lock_acquire (&prepage_lock);
+    prefetch_cnt += loaded;
+    prefetch_cycles += vmstat_clock () - start;
+    lock_release (&prepage_lock);
+  }
+
+  cur->prepage_loads = 0;
+  cur->prepage_until = timer_ticks ()
+                       + (prepage_ms * TIMER_FREQ + 999) / 1000;
+}
+
+/**
+ * Purpose:
+ *  Notes a page about to be loaded by the current process, recording it
+ *  if the process is still inside its startup window
+ *    * only executable pages that are read from the file are recorded,
+ *      zero-fill and swapped pages cost no file I/O at the next start
+ *    * the first load after the window closes ends the recording
+ *
+ * Args:
+ *  spte {spt_entry*} Supplemental page table entry of the page
+ *
+ * Returns:
+ *  None
+ */
+void
+prepage_note (struct spt_entry *spte)
+{
+  struct thread *cur = thread_current ();
+  struct prepage_set *set = cur->prepage_set;
+  size_t i;
+
+  if (cur->prepage_until == 0)
+  {
+    return;
+  }
+  if (timer_ticks () >= cur->prepage_until)
+  {
+    prepage_finish (cur);
+    return;
+  }
+
+  cur->prepage_loads++;
+
+  if (set == NULL || set->cnt == PREPAGE_PAGES || spte->file_pt != cur->elf
+      || spte->read_bytes == 0 || spte->swap_index != -1 || spte->dirty)
+  {
+    return;
+  }
+
+  for (i = 0; i < set->cnt; i++)
+  {
+    if (set->pages[i] == spte->v_addr)
+    {
+      return;
+    }
+  }
+  set->pages[set->cnt++] = spte->v_addr;
+}
+
+/**
+ * Purpose:
+ *  Closes the startup window of a process, publishing the set it
+ *  recorded and adding its page loads to the cold or warm start counters
+ *    * pages are sorted so prefetching reads them in address order
+ *    * a set already published for the binary by a concurrent first
+ *      run is replaced
+ *
+ * Args:
+ *  t {thread*} Process, the current thread
+ *
+ * Returns:
+ *  None
+ */
+static void
+prepage_finish (struct thread *t)
+{
+  struct prepage_set *set = t->prepage_set;
+  size_t i, j;
+
+  t->prepage_set = NULL;
+  t->prepage_until = 0;
+
+  if (set != NULL)
+  {
+    for (i = 1; i < set->cnt; i++)
+    {
+      void *page = set->pages[i];
+      for (j = i; j > 0 && set->pages[j - 1] > page; j--)
+      {
+        set->pages[j] = set->pages[j - 1];
+      }
+      set->pages[j] = page;
+    }
+  }
+
+  lock_acquire (&prepage_lock);
+  if (set == NULL)
+  {
+    warm_cnt++;
+    warm_loads += t->prepage_loads;
+  }
+  else
+  {
+    cold_cnt++;
+    cold_loads += t->prepage_loads;
+
+    if (set->cnt > 0)
+    {
+      struct prepage_set *old = find_set (set->inumber);
+      if (old == NULL && set_cnt == PREPAGE_SETS)
+      {
+        old = list_entry (list_back (&sets), struct prepage_set, elem);
+      }
+      if (old != NULL)
+      {
+        list_remove (&old->elem);
+        set_cnt--;
+        free (old);
+      }
+
+      list_push_front (&sets, &set->elem);
+      set_cnt++;
+      record_cnt++;
+      set = NULL;
+    }
+  }
+  lock_release (&prepage_lock);
+
+  free (set);
+}
+
+/**
+ * Purpose:
+ *  Ends the current process's recording, if any, at exit
+ *
+ * Args:
+ *  None
+ *
+ * Returns:
+ *  None
+ */
+void
+prepage_exit (void)
+{
+  struct thread *cur = thread_current ();
+
+  if (cur->prepage_until != 0)
+  {
+    prepage_finish (cur);
+  }
+}
+
+/**
+ * Purpose:
+ *  Drops the recorded startup pages of a file that was written
+ *    * a running executable denies writes, so a set is never dropped
+ *      while it is recorded
+ *
+ * Args:
+ *  inode {inode*} Inode of the written file
+ *
+ * Returns:
+ *  None
+ */
+void
+prepage_invalidate (struct inode *inode)
+{
+  // nothing recorded yet, also covers writes before `prepage_init`
+  if (set_cnt == 0)
+  {
+    return;
+  }
+
+  lock_acquire (&prepage_lock);
+  struct prepage_set *set = find_set (inode_get_inumber (inode));
+  if (set != NULL)
+  {
+    list_remove (&set->elem);
+    set_cnt--;
+    invalidate_cnt++;
+  }
+  lock_release (&prepage_lock);
+
+  free (set);
+}
+
+/**
+ * Purpose:
+ *  Prints prepaging statistics at shutdown
+ *
+ * Args:
+ *  None
+ *
+ * Returns:
+ *  None
+ */
+void
+prepage_print_stats (void)
+{
+  if (cold_cnt == 0 && warm_cnt == 0)
+  {
+    return;
+  }
+
+  printf ("Prepage: %lld cold starts with %lld page loads, "
+          "%lld warm starts with %lld page loads\n",
+          cold_cnt, cold_loads, warm_cnt, warm_loads);
+  printf ("Prepage: %lld sets recorded, %lld invalidated, "
+          "%lld pages prefetched in %llu cycles\n",
+          record_cnt, invalidate_cnt, prefetch_cnt, prefetch_cycles);
+}
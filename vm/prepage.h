@@ -0,0 +1,88 @@
+#ifndef VM_PREPAGE_H
+#define VM_PREPAGE_H
+
+#include <stddef.h>
+
+struct spt_entry;
+struct inode;
+
+// Milliseconds after exec whose executable page faults are recorded and
+// prefetched on the next exec of the binary, set by `-prepage=MS`, 0
+// disables prepaging
+extern size_t prepage_ms;
+
+/**
+ * Purpose:
+ *  Initializes the table of recorded startup working sets
+ *
+ * Args:
+ *  None
+ *
+ * Returns:
+ *  None
+ */
+void prepage_init (void);
+
+/**
+ * Purpose:
+ *  Starts a freshly loaded process: prefetches the pages recorded for
+ *  its executable, or starts recording them if there is no record
+ *
+ * Args:
+ *  None
+ *
+ * Returns:
+ *  None
+ */
+void prepage_exec (void);
+
+/**
+ * Purpose:
+ *  Notes a page about to be loaded by the current process, recording it
+ *  if the process is still inside its startup window
+ *
+ * Args:
+ *  spte {spt_entry*} Supplemental page table entry of the page
+ *
+ * Returns:
+ *  None
+ */
+void prepage_note (struct spt_entry *spte);
+
+/**
+ * Purpose:
+ *  Ends the current process's recording, if any, at exit
+ *
+ * Args:
+ *  None
+ *
+ * Returns:
+ *  None
+ */
+void prepage_exit (void);
+
+/**
+ * Purpose:
+ *  Drops the recorded startup pages of a file that was written
+ *
+ * Args:
+ *  inode {inode*} Inode of the written file
+ *
+ * Returns:
+ *  None
+ */
+void prepage_invalidate (struct inode *inode);
+
+/**
+ * Purpose:
+ *  Prints prepaging statistics at shutdown
+ *
+ * Args:
+ *  None
+ *
+ * Returns:
+ *  None
+ */
+void prepage_print_stats (void);
+
+#endif /* vm/prepage.h */
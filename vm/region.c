@@ -0,0 +1,629 @@
+#include <debug.h>
+#include <list.h>
+#include <stdio.h>
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "vm/oom.h"
+#include "vm/page.h"
+#include "vm/region.h"
+
+// Regions created, the pages they cover and page entries created in them
+static long long region_cnt;
+static long long region_page_cnt;
+static long long entry_cnt;
+
+bool region_add (void *start, size_t page_cnt, struct file *file, off_t ofs,
+                 uint32_t read_bytes, bool writable, enum region_kind kind);
+struct region *region_find (struct thread *t, const void *addr);
+bool region_overlaps (const void *start, size_t page_cnt);
+struct spt_entry *region_page (struct region *r, void *upage);
+bool region_grow_stack (void *page);
+void region_advise (void *start, size_t size, int advice);
+void region_unmap (void *start, size_t page_cnt);
+bool region_fork (struct thread *parent, struct file *elf);
+bool region_fork_mmap (struct thread *parent, void *start, size_t page_cnt,
+                       struct file *file);
+void region_destroy (void);
+void region_print_stats (void);
+
+static bool region_insert (struct region *r);
+static bool region_anon (const struct region *r);
+static size_t region_pages (const struct region *r);
+static struct region *region_split (struct region *r, uint8_t *addr);
+static void count_region (struct region *r);
+
+/**
+ * Purpose:
+ *  Adds a region to the current process's address space
+ *
+ * Args:
+ *  start          {void*} First page, page aligned
+ *  page_cnt      {size_t} Number of pages
+ *  file           {file*} Backing file, NULL if anonymous
+ *  ofs            {off_t} File offset of `start`
+ *  read_bytes  {uint32_t} Bytes read from the file, the rest is zeroed
+ *  writable        {bool} True if the pages may be written
+ *  kind     {region_kind} What the region holds
+ *
+ * Returns:
+ *  {bool} False if the region overlaps another, memory ran out or its
+ *         anonymous pages could not be committed
+ */
+bool
+region_add (void *start, size_t page_cnt, struct file *file, off_t ofs,
+            uint32_t read_bytes, bool writable, enum region_kind kind)
+{
+  ASSERT (pg_ofs (start) == 0);
+
+  struct region *r = malloc (sizeof *r);
+  if (r == NULL)
+  {
+    return false;
+  }
+
+  r->start = start;
+  r->end = r->start + page_cnt * PGSIZE;
+  r->file = file;
+  r->ofs = ofs;
+  r->read_bytes = read_bytes;
+  r->writable = writable;
+  r->kind = kind;
+  r->advice = MADV_NORMAL;
+
+  if (region_anon (r) && !oom_charge (page_cnt))
+  {
+    free (r);
+    return false;
+  }
+  if (!region_insert (r))
+  {
+    if (region_anon (r))
+    {
+      oom_uncharge (page_cnt);
+    }
+    free (r);
+    return false;
+  }
+
+  count_region (r);
+  return true;
+}
+
+/**
+ * Purpose:
+ *  Inserts a region into the current process's list in address order
+ *
+ * Args:
+ *  r {region*} Region
+ *
+ * Returns:
+ *  {bool} False if it overlaps a region already in the list
+ */
+static bool
+region_insert (struct region *r)
+{
+  struct list *regions = &thread_current ()->regions;
+  struct list_elem *e;
+
+  for (e = list_begin (regions); e != list_end (regions); e = list_next (e))
+  {
+    struct region *next = list_entry (e, struct region, elem);
+    if (next->end <= r->start)
+    {
+      continue;
+    }
+    if (next->start < r->end)
+    {
+      return false;
+    }
+    break;
+  }
+
+  list_insert (e, &r->elem);
+  return true;
+}
+
+/**
+ * Purpose:
+ *  Checks if a region's pages are committed against RAM plus swap
+ *    * writable segments and the stack may be dirtied and then only swap
+ *      can hold them, code and mapped files go back to their file
+ *
+ * Args:
+ *  r {region*} Region
+ *
+ * Returns:
+ *  {bool} True if the region is charged with `oom_charge`
+ */
+static bool
+region_anon (const struct region *r)
+{
+  return r->kind == REGION_DATA || r->kind == REGION_STACK;
+}
+
+/**
+ * Purpose:
+ *  Number of pages a region covers
+ *
+ * Args:
+ *  r {region*} Region
+ *
+ * Returns:
+ *  {size_t} Page count
+ */
+static size_t
+region_pages (const struct region *r)
+{
+  return (r->end - r->start) / PGSIZE;
+}
+
+/**
+ * Purpose:
+ *  Adds a new region to the statistics
+ *
+ * Args:
+ *  r {region*} Region
+ *
+ * Returns:
+ *  None
+ */
+static void
+count_region (struct region *r)
+{
+  enum intr_level old_level = intr_disable ();
+  region_cnt++;
+  region_page_cnt += region_pages (r);
+  intr_set_level (old_level);
+}
+
+/**
+ * Purpose:
+ *  Finds the region holding an address
+ *    * the list is sorted, so the walk stops at the first region past
+ *      the address
+ *
+ * Args:
+ *  t    {thread*} Process
+ *  addr   {void*} User virtual address
+ *
+ * Returns:
+ *  {region*} Region, NULL if the address is in none
+ */
+struct region *
+region_find (struct thread *t, const void *addr)
+{
+  const uint8_t *a = addr;
+  struct list_elem *e;
+
+  for (e = list_begin (&t->regions); e != list_end (&t->regions);
+       e = list_next (e))
+  {
+    struct region *r = list_entry (e, struct region, elem);
+    if (a < r->start)
+    {
+      break;
+    }
+    if (a < r->end)
+    {
+      return r;
+    }
+  }
+
+  return NULL;
+}
+
+/**
+ * Purpose:
+ *  Checks if a range of pages overlaps a region of the current process
+ *
+ * Args:
+ *  start     {void*} First page
+ *  page_cnt {size_t} Number of pages
+ *
+ * Returns:
+ *  {bool} True if any page of the range is in a region
+ */
+bool
+region_overlaps (const void *start, size_t page_cnt)
+{
+  struct list *regions = &thread_current ()->regions;
+  const uint8_t *end = (const uint8_t *) start + page_cnt * PGSIZE;
+  struct list_elem *e;
+
+  for (e = list_begin (regions); e != list_end (regions); e = list_next (e))
+  {
+    struct region *r = list_entry (e, struct region, elem);
+    if (r->start < end && (const uint8_t *) start < r->end)
+    {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+/**
+ * Purpose:
+ *  Creates the supplemental page table entry of a page of a region
+ *    * the page's file range and zero fill follow from its distance to
+ *      the start of the region
+ *
+ * Args:
+ *  r     {region*} Region of the current process holding `upage`
+ *  upage   {void*} Page without an entry yet
+ *
+ * Returns:
+ *  {spt_entry*} New entry, NULL if memory ran out
+ */
+struct spt_entry *
+region_page (struct region *r, void *upage)
+{
+  struct thread *cur = thread_current ();
+  uint32_t delta = (uint8_t *) upage - r->start;
+  uint32_t read_bytes = 0;
+  bool success;
+
+  ASSERT ((uint8_t *) upage >= r->start && (uint8_t *) upage < r->end);
+
+  if (r->file != NULL && delta < r->read_bytes)
+  {
+    read_bytes = r->read_bytes - delta < PGSIZE ? r->read_bytes - delta
+                                                : PGSIZE;
+  }
+
+  if (r->kind == REGION_MMAP)
+  {
+    success = create_mmap_entry (cur->spt, r->file, r->ofs + delta, upage,
+                                 read_bytes, PGSIZE - read_bytes);
+  }
+  else
+  {
+    success = create_spt_entry (cur->spt, r->file, r->ofs + delta, upage,
+                                read_bytes, PGSIZE - read_bytes, r->writable,
+                                r->kind == REGION_STACK);
+  }
+  if (!success)
+  {
+    return NULL;
+  }
+
+  struct spt_entry *spte = list_entry (list_back (cur->spt), struct spt_entry,
+                                       elem);
+  spte->advice = r->advice;
+
+  enum intr_level old_level = intr_disable ();
+  entry_cnt++;
+  intr_set_level (old_level);
+
+  return spte;
+}
+
+/**
+ * Purpose:
+ *  Extends the current process's stack region down to a page
+ *    * the region is created by the first growth and ends below the
+ *      initial stack page, which is mapped outside the supplemental
+ *      page table
+ *
+ * Args:
+ *  page {void*} New lowest stack page
+ *
+ * Returns:
+ *  {bool} False if the stack would run into another region or its new
+ *         pages could not be committed
+ */
+bool
+region_grow_stack (void *page)
+{
+  struct list *regions = &thread_current ()->regions;
+  uint8_t *top = (uint8_t *) PHYS_BASE - PGSIZE;
+  struct list_elem *e;
+
+  if ((uint8_t *) page >= top)
+  {
+    return false;
+  }
+
+  // lowest stack region, regions above it may be split off by madvise
+  for (e = list_begin (regions); e != list_end (regions); e = list_next (e))
+  {
+    struct region *r = list_entry (e, struct region, elem);
+    if (r->kind != REGION_STACK)
+    {
+      continue;
+    }
+    if ((uint8_t *) page >= r->start)
+    {
+      return true;
+    }
+
+    // the region below must end at or below the new page
+    if (e != list_begin (regions)
+        && list_entry (list_prev (e), struct region, elem)->end
+           > (uint8_t *) page)
+    {
+      return false;
+    }
+
+    size_t grow_cnt = (r->start - (uint8_t *) page) / PGSIZE;
+    if (!oom_charge (grow_cnt))
+    {
+      return false;
+    }
+
+    enum intr_level old_level = intr_disable ();
+    region_page_cnt += grow_cnt;
+    intr_set_level (old_level);
+
+    r->start = page;
+    return true;
+  }
+
+  return region_add (page, (top - (uint8_t *) page) / PGSIZE, NULL, 0, 0,
+                     true, REGION_STACK);
+}
+
+/**
+ * Purpose:
+ *  Splits a region in two at a page inside it
+ *
+ * Args:
+ *  r   {region*} Region
+ *  addr {uint8_t*} Page strictly inside `r`, start of the second half
+ *
+ * Returns:
+ *  {region*} Second half, following `r` in the list, NULL if memory ran
+ *            out and `r` was left whole
+ */
+static struct region *
+region_split (struct region *r, uint8_t *addr)
+{
+  uint32_t delta = addr - r->start;
+
+  ASSERT (addr > r->start && addr < r->end);
+
+  struct region *tail = malloc (sizeof *tail);
+  if (tail == NULL)
+  {
+    return NULL;
+  }
+
+  *tail = *r;
+  tail->start = addr;
+  tail->ofs = r->ofs + delta;
+  tail->read_bytes = r->read_bytes > delta ? r->read_bytes - delta : 0;
+  r->end = addr;
+  r->read_bytes = r->read_bytes > delta ? delta : r->read_bytes;
+  list_insert (list_next (&r->elem), &tail->elem);
+
+  return tail;
+}
+
+/**
+ * Purpose:
+ *  Sets the madvise access pattern of the regions in a range, splitting
+ *  regions at its ends
+ *    * if a split runs out of memory, the whole region takes the advice,
+ *      advice is only a hint
+ *
+ * Args:
+ *  start {void*} Start of range, page aligned
+ *  size {size_t} Length of range in bytes
+ *  advice  {int} MADV_NORMAL, MADV_RANDOM or MADV_SEQUENTIAL
+ *
+ * Returns:
+ *  None
+ */
+void
+region_advise (void *start, size_t size, int advice)
+{
+  struct list *regions = &thread_current ()->regions;
+  uint8_t *lo = start;
+  uint8_t *hi = pg_round_up (lo + size);
+  struct list_elem *e;
+
+  for (e = list_begin (regions); e != list_end (regions); e = list_next (e))
+  {
+    struct region *r = list_entry (e, struct region, elem);
+    if (r->end <= lo)
+    {
+      continue;
+    }
+    if (r->start >= hi)
+    {
+      break;
+    }
+
+    if (r->start < lo && region_split (r, lo) != NULL)
+    {
+      // advice belongs to the second half, visited next
+      continue;
+    }
+    if (r->end > hi)
+    {
+      region_split (r, hi);
+    }
+    r->advice = advice;
+  }
+}
+
+/**
+ * Purpose:
+ *  Removes the regions of a range of the current process, their page
+ *  entries must be gone already
+ *
+ * Args:
+ *  start     {void*} First page
+ *  page_cnt {size_t} Number of pages
+ *
+ * Returns:
+ *  None
+ */
+void
+region_unmap (void *start, size_t page_cnt)
+{
+  struct list *regions = &thread_current ()->regions;
+  uint8_t *lo = start;
+  uint8_t *hi = lo + page_cnt * PGSIZE;
+  struct list_elem *e = list_begin (regions);
+
+  while (e != list_end (regions))
+  {
+    struct region *r = list_entry (e, struct region, elem);
+    e = list_next (e);
+
+    if (r->start >= lo && r->end <= hi)
+    {
+      if (region_anon (r))
+      {
+        oom_uncharge (region_pages (r));
+      }
+      list_remove (&r->elem);
+      free (r);
+    }
+  }
+}
+
+/**
+ * Purpose:
+ *  Copies a forking process's regions other than memory mappings into
+ *  the current process, the child
+ *    * the child's regions of the executable refer to its own handle
+ *
+ * Args:
+ *  parent {thread*} Forking process
+ *  elf      {file*} Child's own handle on the executable
+ *
+ * Returns:
+ *  {bool} False if memory ran out or the child's anonymous pages could
+ *         not be committed
+ */
+bool
+region_fork (struct thread *parent, struct file *elf)
+{
+  struct thread *cur = thread_current ();
+  struct list_elem *e;
+
+  for (e = list_begin (&parent->regions); e != list_end (&parent->regions);
+       e = list_next (e))
+  {
+    struct region *p = list_entry (e, struct region, elem);
+    if (p->kind == REGION_MMAP)
+    {
+      continue;
+    }
+
+    struct region *c = malloc (sizeof *c);
+    if (c == NULL)
+    {
+      return false;
+    }
+    *c = *p;
+    if (region_anon (c) && !oom_charge (region_pages (c)))
+    {
+      free (c);
+      return false;
+    }
+    if (c->file == parent->elf)
+    {
+      c->file = elf;
+    }
+
+    // parent's list is sorted, so is the child's
+    list_push_back (&cur->regions, &c->elem);
+    count_region (c);
+  }
+
+  return true;
+}
+
+/**
+ * Purpose:
+ *  Copies the regions of a forking process's memory mapping into the
+ *  current process, the child
+ *
+ * Args:
+ *  parent {thread*} Forking process
+ *  start    {void*} First page of the mapping
+ *  page_cnt {size_t} Number of pages
+ *  file     {file*} Child's own handle on the mapped file
+ *
+ * Returns:
+ *  {bool} False if memory ran out
+ */
+bool
+region_fork_mmap (struct thread *parent, void *start, size_t page_cnt,
+                  struct file *file)
+{
+  uint8_t *lo = start;
+  uint8_t *hi = lo + page_cnt * PGSIZE;
+  struct list_elem *e;
+
+  for (e = list_begin (&parent->regions); e != list_end (&parent->regions);
+       e = list_next (e))
+  {
+    struct region *p = list_entry (e, struct region, elem);
+    if (p->kind != REGION_MMAP || p->start < lo || p->end > hi)
+    {
+      continue;
+    }
+
+    if (!region_add (p->start, (p->end - p->start) / PGSIZE, file, p->ofs,
+                     p->read_bytes, p->writable, REGION_MMAP))
+    {
+      return false;
+    }
+    region_find (thread_current (), p->start)->advice = p->advice;
+  }
+
+  return true;
+}
+
+/**
+ * Purpose:
+ *  Frees every region of the current process
+ *
+ * Args:
+ *  None
+ *
+ * Returns:
+ *  None
+ */
+void
+region_destroy (void)
+{
+  struct list *regions = &thread_current ()->regions;
+
+  while (!list_empty (regions))
+  {
+    struct region *r = list_entry (list_pop_front (regions), struct region,
+                                   elem);
+    if (region_anon (r))
+    {
+      oom_uncharge (region_pages (r));
+    }
+    free (r);
+  }
+}
+
+/**
+ * Purpose:
+ *  Prints region statistics at shutdown
+ *
+ * Args:
+ *  None
+ *
+ * Returns:
+ *  None
+ */
+void
+region_print_stats (void)
+{
+  printf ("Region: %lld regions covering %lld pages, "
+          "%lld page entries created\n",
+          region_cnt, region_page_cnt, entry_cnt);
+  printf ("Region: %zu bytes per region, %zu bytes per page entry\n",
+          sizeof (struct region), sizeof (struct spt_entry));
+}
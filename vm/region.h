@@ -0,0 +1,209 @@
+#ifndef VM_REGION_H
+#define VM_REGION_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "lib/kernel/list.h"
+#include "filesys/off_t.h"
+
+struct file;
+struct thread;
+struct spt_entry;
+
+// what a region of the address space holds
+enum region_kind
+{
+  REGION_CODE,
+  REGION_DATA,
+  REGION_STACK,
+  REGION_MMAP
+};
+
+// run of pages with the same backing and permissions, a process's
+// regions are kept sorted by address in `regions` of its thread; pages
+// get a supplemental page table entry only once they are touched
+struct region
+{
+  // first page and end of the region, page aligned, `end` exclusive
+  uint8_t *start;
+  uint8_t *end;
+
+  // backing file and file offset of `start`, NULL file if anonymous
+  struct file *file;
+  off_t ofs;
+
+  // bytes read from the file counted from `start`, the rest is zeroed
+  uint32_t read_bytes;
+
+  // True if the pages may be written
+  bool writable;
+
+  // code, data, stack or memory mapped file
+  enum region_kind kind;
+
+  // madvise access pattern new page entries start with
+  int advice;
+
+  // list element in the thread's `regions`
+  struct list_elem elem;
+};
+
+/**
+ * Purpose:
+ *  Adds a region to the current process's address space
+ *
+ * Args:
+ *  start          {void*} First page, page aligned
+ *  page_cnt      {size_t} Number of pages
+ *  file           {file*} Backing file, NULL if anonymous
+ *  ofs            {off_t} File offset of `start`
+ *  read_bytes  {uint32_t} Bytes read from the file, the rest is zeroed
+ *  writable        {bool} True if the pages may be written
+ *  kind     {region_kind} What the region holds
+ *
+ * Returns:
+ *  {bool} False if the region overlaps another, memory ran out or its
+ *         anonymous pages could not be committed
+ */
+bool region_add (void *start, size_t page_cnt, struct file *file, off_t ofs,
+                 uint32_t read_bytes, bool writable, enum region_kind kind);
+
+/**
+ * Purpose:
+ *  Finds the region holding an address
+ *
+ * Args:
+ *  t    {thread*} Process
+ *  addr   {void*} User virtual address
+ *
+ * Returns:
+ *  {region*} Region, NULL if the address is in none
+ */
+struct region *region_find (struct thread *t, const void *addr);
+
+/**
+ * Purpose:
+ *  Checks if a range of pages overlaps a region of the current process
+ *
+ * Args:
+ *  start     {void*} First page
+ *  page_cnt {size_t} Number of pages
+ *
+ * Returns:
+ *  {bool} True if any page of the range is in a region
+ */
+bool region_overlaps (const void *start, size_t page_cnt);
+
+/**
+ * Purpose:
+ *  Creates the supplemental page table entry of a page of a region
+ *
+ * Args:
+ *  r     {region*} Region of the current process holding `upage`
+ *  upage   {void*} Page without an entry yet
+ *
+ * Returns:
+ *  {spt_entry*} New entry, NULL if memory ran out
+ */
+struct spt_entry *region_page (struct region *r, void *upage);
+
+/**
+ * Purpose:
+ *  Extends the current process's stack region down to a page
+ *
+ * Args:
+ *  page {void*} New lowest stack page
+ *
+ * Returns:
+ *  {bool} False if the stack would run into another region or its new
+ *         pages could not be committed
+ */
+bool region_grow_stack (void *page);
+
+/**
+ * Purpose:
+ *  Sets the madvise access pattern of the regions in a range, splitting
+ *  regions at its ends
+ *
+ * Args:
+ *  start {void*} Start of range, page aligned
+ *  size {size_t} Length of range in bytes
+ *  advice  {int} MADV_NORMAL, MADV_RANDOM or MADV_SEQUENTIAL
+ *
+ * Returns:
+ *  None
+ */
+void region_advise (void *start, size_t size, int advice);
+
+/**
+ * Purpose:
+ *  Removes the regions of a range of the current process, their page
+ *  entries must be gone already
+ *
+ * Args:
+ *  start     {void*} First page
+ *  page_cnt {size_t} Number of pages
+ *
+ * Returns:
+ *  None
+ */
+void region_unmap (void *start, size_t page_cnt);
+
+/**
+ * Purpose:
+ *  Copies a forking process's regions other than memory mappings into
+ *  the current process, the child
+ *
+ * Args:
+ *  parent {thread*} Forking process
+ *  elf      {file*} Child's own handle on the executable
+ *
+ * Returns:
+ *  {bool} False if memory ran out or the child's anonymous pages could
+ *         not be committed
+ */
+bool region_fork (struct thread *parent, struct file *elf);
+
+/**
+ * Purpose:
+ *  Copies the regions of a forking process's memory mapping into the
+ *  current process, the child
+ *
+ * Args:
+ *  parent {thread*} Forking process
+ *  start    {void*} First page of the mapping
+ *  page_cnt {size_t} Number of pages
+ *  file     {file*} Child's own handle on the mapped file
+ *
+ * Returns:
+ *  {bool} False if memory ran out
+ */
+bool region_fork_mmap (struct thread *parent, void *start, size_t page_cnt,
+                       struct file *file);
+
+/**
+ * Purpose:
+ *  Frees every region of the current process
+ *
+ * Args:
+ *  None
+ *
+ * Returns:
+ *  None
+ */
+void region_destroy (void);
+
+/**
+ * Purpose:
+ *  Prints region statistics at shutdown
+ *
+ * Args:
+ *  None
+ *
+ * Returns:
+ *  None
+ */
+void region_print_stats (void);
+
+#endif /* vm/region.h */
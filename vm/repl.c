@@ -0,0 +1,618 @@
+#include <debug.h>
+#include <list.h>
+#include <stdio.h>
+#include <string.h>
+#include "vm/frame.h"
+#include "vm/page.h"
+#include "vm/repl.h"
+
+// resident frames on the lists of 2Q and ARC, and ghosts of evicted
+// pages, with their lengths; indexed by `enum repl_list`
+static struct list lists[REPL_LIST_CNT];
+static size_t lens[REPL_LIST_CNT];
+
+// Number of user frames
+static size_t frame_cnt;
+
+// Hands of the clock and of enhanced second chance into the frame table
+static size_t clock_hand;
+static size_t esc_hand;
+
+// 2Q: target length of A1in and most ghosts kept in A1out
+static size_t q2_in_max;
+static size_t q2_out_max;
+
+// ARC: adaptive target length of T1
+static size_t arc_target;
+
+// Faults on pages still in a ghost list
+static long long ghost_hit_cnt;
+
+void repl_forget (struct spt_entry *spte);
+bool repl_select (const char *name);
+void repl_print_stats (void);
+
+static void lists_init (size_t cnt);
+static void scan_insert (struct ft_entry *entry);
+static void scan_remove (struct ft_entry *entry, bool evicted);
+static void queue_move (struct ft_entry *entry, enum repl_list id);
+static void ghost_move (struct spt_entry *spte, enum repl_list id);
+static void ghost_trim (enum repl_list id);
+static struct ft_entry *queue_clock (enum repl_list id);
+
+static struct ft_entry *clock_victim (void);
+static struct ft_entry *esc_victim (void);
+static void q2_insert (struct ft_entry *entry);
+static void q2_remove (struct ft_entry *entry, bool evicted);
+static struct ft_entry *q2_victim (void);
+static void arc_insert (struct ft_entry *entry);
+static void arc_remove (struct ft_entry *entry, bool evicted);
+static struct ft_entry *arc_victim (void);
+
+/**
+ * Purpose:
+ *  Insert of the policies that scan the frame table and keep no lists
+ *
+ * Args:
+ *  entry {ft_entry*} Frame table entry
+ *
+ * Returns:
+ *  None
+ */
+static void
+scan_insert (struct ft_entry *entry UNUSED)
+{
+}
+
+/**
+ * Purpose:
+ *  Remove of the policies that scan the frame table and keep no lists
+ *
+ * Args:
+ *  entry {ft_entry*} Frame table entry
+ *  evicted   {bool} True if the page is evicted rather than freed
+ *
+ * Returns:
+ *  None
+ */
+static void
+scan_remove (struct ft_entry *entry UNUSED, bool evicted UNUSED)
+{
+}
+
+static const struct repl_policy policies[] =
+{
+  { "clock", lists_init, scan_insert, scan_remove, clock_victim },
+  { "esc", lists_init, scan_insert, scan_remove, esc_victim },
+  { "2q", lists_init, q2_insert, q2_remove, q2_victim },
+  { "arc", lists_init, arc_insert, arc_remove, arc_victim },
+};
+
+const struct repl_policy *repl_policy = &policies[0];
+
+/**
+ * Purpose:
+ *  Picks the replacement policy by name, before `init_frame`
+ *
+ * Args:
+ *  name {const char*} clock, esc, 2q or arc
+ *
+ * Returns:
+ *  {bool} False if there is no such policy
+ */
+bool
+repl_select (const char *name)
+{
+  size_t i;
+
+  for (i = 0; i < sizeof policies / sizeof *policies; i++)
+  {
+    if (!strcmp (policies[i].name, name))
+    {
+      repl_policy = &policies[i];
+      return true;
+    }
+  }
+
+  return false;
+}
+
+/**
+ * Purpose:
+ *  Sets up the lists and their length targets for `cnt` user frames
+ *    * 2Q keeps a quarter of the frames for pages seen once and
+ *      remembers half as many evicted pages as there are frames, the
+ *      settings its authors recommend
+ *
+ * Args:
+ *  cnt {size_t} Number of user frames
+ *
+ * Returns:
+ *  None
+ */
+static void
+lists_init (size_t cnt)
+{
+  size_t i;
+
+  for (i = 0; i < REPL_LIST_CNT; i++)
+  {
+    list_init (&lists[i]);
+  }
+
+  frame_cnt = cnt;
+  q2_in_max = cnt / 4 > 0 ? cnt / 4 : 1;
+  q2_out_max = cnt / 2 > 0 ? cnt / 2 : 1;
+  arc_target = 0;
+}
+
+/**
+ * Purpose:
+ *  Moves a frame to the tail of a list, or off its list for REPL_NONE
+ *
+ * Args:
+ *  entry {ft_entry*} Frame table entry
+ *  id {repl_list} List to append the frame to
+ *
+ * Returns:
+ *  None
+ */
+static void
+queue_move (struct ft_entry *entry, enum repl_list id)
+{
+  if (entry->repl_list != REPL_NONE)
+  {
+    list_remove (&entry->repl_elem);
+    lens[entry->repl_list]--;
+  }
+  if (id != REPL_NONE)
+  {
+    list_push_back (&lists[id], &entry->repl_elem);
+    lens[id]++;
+  }
+  entry->repl_list = id;
+}
+
+/**
+ * Purpose:
+ *  Moves a page to the tail of a ghost list, or off its ghost list for
+ *  REPL_NONE
+ *
+ * Args:
+ *  spte {spt_entry*} Supplemental page table entry of the page
+ *  id {repl_list} Ghost list to append the page to
+ *
+ * Returns:
+ *  None
+ */
+static void
+ghost_move (struct spt_entry *spte, enum repl_list id)
+{
+  if (spte->repl_ghost != REPL_NONE)
+  {
+    list_remove (&spte->ghost_elem);
+    lens[spte->repl_ghost]--;
+  }
+  if (id != REPL_NONE)
+  {
+    list_push_back (&lists[id], &spte->ghost_elem);
+    lens[id]++;
+  }
+  spte->repl_ghost = id;
+}
+
+/**
+ * Purpose:
+ *  Forgets the oldest ghost of a list
+ *
+ * Args:
+ *  id {repl_list} Ghost list, not empty
+ *
+ * Returns:
+ *  None
+ */
+static void
+ghost_trim (enum repl_list id)
+{
+  ASSERT (lens[id] > 0);
+
+  ghost_move (list_entry (list_front (&lists[id]), struct spt_entry,
+                          ghost_elem), REPL_NONE);
+}
+
+/**
+ * Purpose:
+ *  Drops a page from the ghost lists, must be called with `ft_lock` held
+ *
+ * Args:
+ *  spte {spt_entry*} Supplemental page table entry of the page
+ *
+ * Returns:
+ *  None
+ */
+void
+repl_forget (struct spt_entry *spte)
+{
+  ghost_move (spte, REPL_NONE);
+}
+
+/**
+ * Purpose:
+ *  Second-chance clock over one list: referenced and pinned frames at
+ *  the head are rotated to the tail
+ *
+ * Args:
+ *  id {repl_list} List of resident frames
+ *
+ * Returns:
+ *  {ft_entry*} Unreferenced frame at the head, NULL if two rounds found
+ *              none
+ */
+static struct ft_entry *
+queue_clock (enum repl_list id)
+{
+  size_t iter;
+  size_t limit = 2 * lens[id];
+
+  for (iter = 0; iter < limit; iter++)
+  {
+    struct ft_entry *entry = list_entry (list_front (&lists[id]),
+                                         struct ft_entry, repl_elem);
+    if (frame_evictable (entry) && !frame_referenced (entry, true))
+    {
+      return entry;
+    }
+    queue_move (entry, id);
+  }
+
+  return NULL;
+}
+
+/**
+ * Purpose:
+ *  Clock: global second-chance clock over the frames of all processes
+ *
+ * Args:
+ *  None
+ *
+ * Returns:
+ *  {ft_entry*} Frame to evict, NULL if every frame is pinned
+ */
+static struct ft_entry *
+clock_victim (void)
+{
+  size_t iter;
+
+  for (iter = 0; iter < 2 * frame_cnt; iter++)
+  {
+    struct ft_entry *entry = frame_at (clock_hand);
+    clock_hand = (clock_hand + 1) % frame_cnt;
+
+    if (frame_evictable (entry) && !frame_referenced (entry, true))
+    {
+      return entry;
+    }
+  }
+
+  return NULL;
+}
+
+/**
+ * Purpose:
+ *  Enhanced second chance: the clock prefers unreferenced clean frames,
+ *  which need no write-back, over unreferenced dirty ones
+ *    * rounds alternate between looking for an unreferenced clean frame,
+ *      leaving the bits alone, and taking any unreferenced frame while
+ *      clearing accessed bits; after the fourth round every frame has
+ *      been considered in each class
+ *
+ * Args:
+ *  None
+ *
+ * Returns:
+ *  {ft_entry*} Frame to evict, NULL if every frame is pinned
+ */
+static struct ft_entry *
+esc_victim (void)
+{
+  int round;
+  size_t iter;
+
+  for (round = 0; round < 4; round++)
+  {
+    bool clean_only = round % 2 == 0;
+
+    for (iter = 0; iter < frame_cnt; iter++)
+    {
+      struct ft_entry *entry = frame_at (esc_hand);
+      esc_hand = (esc_hand + 1) % frame_cnt;
+
+      if (!frame_evictable (entry))
+      {
+        continue;
+      }
+      if (clean_only)
+      {
+        if (!frame_referenced (entry, false) && !frame_dirty (entry))
+        {
+          return entry;
+        }
+      }
+      else if (!frame_referenced (entry, true))
+      {
+        return entry;
+      }
+    }
+  }
+
+  return NULL;
+}
+
+/**
+ * Purpose:
+ *  2Q: a new page goes to the A1in FIFO, a page evicted from A1in
+ *  not long ago is reused and goes to the Am clock
+ *
+ * Args:
+ *  entry {ft_entry*} Frame table entry
+ *
+ * Returns:
+ *  None
+ */
+static void
+q2_insert (struct ft_entry *entry)
+{
+  struct spt_entry *spte = entry->spte;
+
+  if (spte->repl_ghost == REPL_A1OUT)
+  {
+    ghost_hit_cnt++;
+    ghost_move (spte, REPL_NONE);
+    queue_move (entry, REPL_AM);
+  }
+  else
+  {
+    queue_move (entry, REPL_A1IN);
+  }
+}
+
+/**
+ * Purpose:
+ *  2Q: takes a frame off its list, a page evicted from A1in is
+ *  remembered in A1out
+ *    * shared frames are remembered by none of their sharers
+ *
+ * Args:
+ *  entry {ft_entry*} Frame table entry
+ *  evicted   {bool} True if the page is evicted rather than freed
+ *
+ * Returns:
+ *  None
+ */
+static void
+q2_remove (struct ft_entry *entry, bool evicted)
+{
+  enum repl_list from = entry->repl_list;
+
+  queue_move (entry, REPL_NONE);
+  if (evicted && from == REPL_A1IN && !entry->shared)
+  {
+    ghost_move (entry->spte, REPL_A1OUT);
+    if (lens[REPL_A1OUT] > q2_out_max)
+    {
+      ghost_trim (REPL_A1OUT);
+    }
+  }
+}
+
+/**
+ * Purpose:
+ *  2Q: evicts from the A1in FIFO while it is over its target, so pages
+ *  touched in one burst and never again leave first, otherwise from Am
+ *    * references in A1in are not counted, they come from the burst
+ *
+ * Args:
+ *  None
+ *
+ * Returns:
+ *  {ft_entry*} Frame to evict, NULL if every frame is pinned
+ */
+static struct ft_entry *
+q2_victim (void)
+{
+  struct ft_entry *victim = NULL;
+  struct list_elem *e;
+
+  if (lens[REPL_A1IN] > q2_in_max || lens[REPL_AM] == 0)
+  {
+    for (e = list_begin (&lists[REPL_A1IN]); e != list_end (&lists[REPL_A1IN]);
+         e = list_next (e))
+    {
+      struct ft_entry *entry = list_entry (e, struct ft_entry, repl_elem);
+      if (frame_evictable (entry))
+      {
+        return entry;
+      }
+    }
+  }
+
+  victim = queue_clock (REPL_AM);
+  if (victim == NULL && lens[REPL_A1IN] > 0)
+  {
+    victim = queue_clock (REPL_A1IN);
+  }
+
+  return victim;
+}
+
+/**
+ * Purpose:
+ *  ARC: a new page goes to T1, a page still remembered in B1 or B2 goes
+ *  to T2 and moves the T1 target towards the list it was found in
+ *    * on a miss in both ghost lists, the oldest ghosts are forgotten so
+ *      T1 and B1 hold at most one cache worth of pages and all four
+ *      lists two
+ *
+ * Args:
+ *  entry {ft_entry*} Frame table entry
+ *
+ * Returns:
+ *  None
+ */
+static void
+arc_insert (struct ft_entry *entry)
+{
+  struct spt_entry *spte = entry->spte;
+  size_t step;
+
+  entry->repl_fresh = true;
+
+  if (spte->repl_ghost == REPL_B1)
+  {
+    // T1 was too small for this page
+    step = lens[REPL_B2] > lens[REPL_B1] ? lens[REPL_B2] / lens[REPL_B1] : 1;
+    arc_target = arc_target + step < frame_cnt ? arc_target + step : frame_cnt;
+    ghost_hit_cnt++;
+    ghost_move (spte, REPL_NONE);
+    queue_move (entry, REPL_T2);
+  }
+  else if (spte->repl_ghost == REPL_B2)
+  {
+    // T2 was too small for this page
+    step = lens[REPL_B1] > lens[REPL_B2] ? lens[REPL_B1] / lens[REPL_B2] : 1;
+    arc_target = arc_target > step ? arc_target - step : 0;
+    ghost_hit_cnt++;
+    ghost_move (spte, REPL_NONE);
+    queue_move (entry, REPL_T2);
+  }
+  else
+  {
+    if (lens[REPL_T1] + lens[REPL_B1] >= frame_cnt && lens[REPL_B1] > 0)
+    {
+      ghost_trim (REPL_B1);
+    }
+    else if (lens[REPL_T1] + lens[REPL_T2] + lens[REPL_B1] + lens[REPL_B2]
+             >= 2 * frame_cnt && lens[REPL_B2] > 0)
+    {
+      ghost_trim (REPL_B2);
+    }
+    queue_move (entry, REPL_T1);
+  }
+}
+
+/**
+ * Purpose:
+ *  ARC: takes a frame off its list, an evicted page is remembered in the
+ *  ghost list of the list it left
+ *    * ghosts are also trimmed here, as the page-out daemon evicts
+ *      without inserting
+ *
+ * Args:
+ *  entry {ft_entry*} Frame table entry
+ *  evicted   {bool} True if the page is evicted rather than freed
+ *
+ * Returns:
+ *  None
+ */
+static void
+arc_remove (struct ft_entry *entry, bool evicted)
+{
+  enum repl_list from = entry->repl_list;
+
+  queue_move (entry, REPL_NONE);
+  if (!evicted || entry->shared)
+  {
+    return;
+  }
+
+  ghost_move (entry->spte, from == REPL_T1 ? REPL_B1 : REPL_B2);
+  if (lens[REPL_T1] + lens[REPL_B1] > frame_cnt)
+  {
+    ghost_trim (REPL_B1);
+  }
+  if (lens[REPL_B1] + lens[REPL_B2] > frame_cnt)
+  {
+    ghost_trim (lens[REPL_B2] > 0 ? REPL_B2 : REPL_B1);
+  }
+}
+
+/**
+ * Purpose:
+ *  ARC: evicts from T1 while it is at least its target, else from T2,
+ *  with a clock over each list in the manner of CAR, since the MMU
+ *  reports references only through accessed bits
+ *    * a referenced T1 frame moves to T2, a referenced T2 frame to the
+ *      tail of T2
+ *    * the first reference of a new page is the fault that loaded it
+ *      and only keeps the page in its list for one more round
+ *
+ * Args:
+ *  None
+ *
+ * Returns:
+ *  {ft_entry*} Frame to evict, NULL if every frame is pinned
+ */
+static struct ft_entry *
+arc_victim (void)
+{
+  size_t iter;
+  size_t limit = 2 * (lens[REPL_T1] + lens[REPL_T2]) + 1;
+
+  for (iter = 0; iter < limit; iter++)
+  {
+    size_t target = arc_target > 0 ? arc_target : 1;
+    enum repl_list id = lens[REPL_T1] > 0
+                        && (lens[REPL_T1] >= target || lens[REPL_T2] == 0)
+                        ? REPL_T1 : REPL_T2;
+    if (lens[id] == 0)
+    {
+      return NULL;
+    }
+
+    struct ft_entry *entry = list_entry (list_front (&lists[id]),
+                                         struct ft_entry, repl_elem);
+    if (!frame_evictable (entry))
+    {
+      queue_move (entry, id);
+    }
+    else if (frame_referenced (entry, true))
+    {
+      if (entry->repl_fresh)
+      {
+        entry->repl_fresh = false;
+        queue_move (entry, id);
+      }
+      else
+      {
+        queue_move (entry, REPL_T2);
+      }
+    }
+    else
+    {
+      return entry;
+    }
+  }
+
+  return NULL;
+}
+
+/**
+ * Purpose:
+ *  Prints replacement policy statistics at shutdown
+ *
+ * Args:
+ *  None
+ *
+ * Returns:
+ *  None
+ */
+void
+repl_print_stats (void)
+{
+  printf ("Repl: %s policy, %lld faults on remembered pages\n",
+          repl_policy->name, ghost_hit_cnt);
+  if (repl_policy->insert == arc_insert)
+  {
+    printf ("Repl: T1 target %zu of %zu frames\n", arc_target, frame_cnt);
+  }
+}
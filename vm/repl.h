@@ -0,0 +1,90 @@
+#ifndef VM_REPL_H
+#define VM_REPL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+struct ft_entry;
+struct spt_entry;
+
+// Lists of the replacement policies, `repl_list` of a resident frame or
+// `repl_ghost` of a recently evicted page; clock and enhanced second
+// chance scan the frame table instead and leave both at REPL_NONE
+enum repl_list
+{
+  REPL_NONE,
+
+  // 2Q: pages seen once, pages seen again, ghosts evicted from A1in
+  REPL_A1IN,
+  REPL_AM,
+  REPL_A1OUT,
+
+  // ARC: recency and frequency lists and their ghosts
+  REPL_T1,
+  REPL_T2,
+  REPL_B1,
+  REPL_B2,
+
+  REPL_LIST_CNT
+};
+
+// page replacement policy, every operation is called with `ft_lock` held
+struct repl_policy
+{
+  // name selecting the policy with `-repl=NAME`
+  const char *name;
+
+  // sets up the policy for `frame_cnt` user frames
+  void (*init) (size_t frame_cnt);
+
+  // frame was just given the page of its `spte`
+  void (*insert) (struct ft_entry *entry);
+
+  // frame loses its page, `evicted` if the policy or the quota picked
+  // it rather than the page being freed
+  void (*remove) (struct ft_entry *entry, bool evicted);
+
+  // next frame to evict, left in place, NULL if every frame is pinned
+  struct ft_entry *(*victim) (void);
+};
+
+// Policy in use, clock unless `-repl=NAME` picks another
+extern const struct repl_policy *repl_policy;
+
+/**
+ * Purpose:
+ *  Picks the replacement policy by name, before `init_frame`
+ *
+ * Args:
+ *  name {const char*} clock, esc, 2q or arc
+ *
+ * Returns:
+ *  {bool} False if there is no such policy
+ */
+bool repl_select (const char *name);
+
+/**
+ * Purpose:
+ *  Drops a page from the ghost lists, must be called with `ft_lock` held
+ *
+ * Args:
+ *  spte {spt_entry*} Supplemental page table entry of the page
+ *
+ * Returns:
+ *  None
+ */
+void repl_forget (struct spt_entry *spte);
+
+/**
+ * Purpose:
+ *  Prints replacement policy statistics at shutdown
+ *
+ * Args:
+ *  None
+ *
+ * Returns:
+ *  None
+ */
+void repl_print_stats (void);
+
+#endif /* vm/repl.h */
@@ -0,0 +1,37 @@
+#!/bin/bash
+
+# Compares copying a file with read/write (examples/cp) against copying
+# it through two memory mappings (examples/mcp). Run from vm/ after
+# `make` here and in ../examples. Prints the kernel's timer ticks for
+# each run, lower is better.
+
+SIZE_KB=${1:-256}
+DATA=build/bench.data
+EXAMPLES=../examples
+
+if [ ! -x $EXAMPLES/cp ] || [ ! -x $EXAMPLES/mcp ]; then
+    echo "ERROR: build ../examples first"
+    exit 1
+fi
+
+# random contents so the copy can be checked with cmp afterwards
+head -c $((SIZE_KB * 1024)) /dev/urandom > $DATA
+
+for prog in cp mcp; do
+
+    # add line spacing between runs
+    echo ""
+    echo "$prog: $SIZE_KB kB"
+
+    cd build
+    pintos -v -k -T 120 --filesys-size=4 --swap-size=4		\
+        -p ../$EXAMPLES/$prog -a $prog			\
+        -p ../$EXAMPLES/cmp -a cmp			\
+        -p bench.data -a data					\
+        -- -q -f run "$prog data copy" run "cmp data copy"	\
+        2> /dev/null | grep -E "Timer:|cmp|exit\("
+    cd ..
+
+done
+
+rm $DATA 2> /dev/null
@@ -0,0 +1,22 @@
+#!/bin/bash
+
+# Process teardown benchmark: runs examples/execbench, which execs and
+# reaps ITERS short-lived children one after the other. Run from vm/
+# after `make` here and in ../examples. Prints the kernel's timer ticks
+# and frame statistics; if exit leaked frames or swap slots, the run
+# would fail partway with "child N of ITERS failed".
+
+ITERS=${1:-10000}
+EXAMPLES=../examples
+
+if [ ! -x $EXAMPLES/execbench ]; then
+    echo "ERROR: build ../examples first"
+    exit 1
+fi
+
+cd build
+pintos -v -k -T 3600 --filesys-size=2 --swap-size=4		\
+    -p ../$EXAMPLES/execbench -a execbench				\
+    -- -q -f run "execbench $ITERS"				\
+    2> /dev/null | grep -E "Timer:|VM:|execbench:"
+cd ..
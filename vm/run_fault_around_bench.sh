@@ -0,0 +1,30 @@
+#!/bin/bash
+
+# Fault-around benchmark: runs examples/fabench, which execs ITERS
+# children that each touch a large read-only segment before their first
+# output, with -fa=1 (one page per fault) and with the default window.
+# Run from vm/ after `make` here and in ../examples. Prints the kernel's
+# timer ticks for each run, lower is better, and the last child's faults.
+
+ITERS=${1:-200}
+EXAMPLES=../examples
+
+if [ ! -x $EXAMPLES/fabench ]; then
+    echo "ERROR: build ../examples first"
+    exit 1
+fi
+
+for opt in "-fa=1" ""; do
+
+    # add line spacing between runs
+    echo ""
+    echo "fabench: $ITERS children ${opt:-(default window)}"
+
+    cd build
+    pintos -v -k -T 600 --filesys-size=2 --swap-size=4		\
+        -p ../$EXAMPLES/fabench -a fabench				\
+        -- -q $opt -f run "fabench $ITERS"				\
+        2> /dev/null | grep -E "Timer:|fabench:"
+    cd ..
+
+done
@@ -0,0 +1,30 @@
+#!/bin/bash
+
+# Fork-exit microbenchmark: forks examples/forkbench children that write
+# a varying part of a fixed mapped area. Run from vm/ after `make` here
+# and in ../examples. With copy-on-write fork the timer ticks grow with
+# the touched size, not with the mapped size.
+
+MAPPED_KB=${1:-512}
+ITERS=${2:-20}
+EXAMPLES=../examples
+
+if [ ! -x $EXAMPLES/forkbench ]; then
+    echo "ERROR: build ../examples first"
+    exit 1
+fi
+
+for touched in 0 64 128 256 $MAPPED_KB; do
+
+    # add line spacing between runs
+    echo ""
+    echo "forkbench: $MAPPED_KB kB mapped, $touched kB touched"
+
+    cd build
+    pintos -v -k -T 300 --filesys-size=2 --swap-size=4		\
+        -p ../$EXAMPLES/forkbench -a forkbench			\
+        -- -q -f run "forkbench $MAPPED_KB $touched $ITERS"	\
+        2> /dev/null | grep -E "Timer:|forkbench:"
+    cd ..
+
+done
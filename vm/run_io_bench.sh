@@ -0,0 +1,29 @@
+#!/bin/bash
+
+# Syscall buffer microbenchmark: runs examples/iobench with growing
+# read/write buffer sizes. Run from vm/ after `make` here and in
+# ../examples. Prints the kernel's timer ticks for each run; with page
+# granular buffer pinning the ticks per byte fall as the buffer grows.
+
+ITERS=${1:-20}
+EXAMPLES=../examples
+
+if [ ! -x $EXAMPLES/iobench ]; then
+    echo "ERROR: build ../examples first"
+    exit 1
+fi
+
+for bufsize in 64 512 4096 16384 65536; do
+
+    # add line spacing between runs
+    echo ""
+    echo "iobench: $bufsize byte buffers"
+
+    cd build
+    pintos -v -k -T 300 --filesys-size=2 --swap-size=4		\
+        -p ../$EXAMPLES/iobench -a iobench				\
+        -- -q -f run "iobench $bufsize $ITERS"			\
+        2> /dev/null | grep -E "Timer:|iobench:"
+    cd ..
+
+done
@@ -0,0 +1,29 @@
+#!/bin/bash
+
+# 4 MB page microbenchmark: runs examples/matmult with the kernel direct
+# map built from 4 MB pages and, with -nopse, from 4 kB pages only. Run
+# from vm/ after `make` here and in ../examples. Prints the kernel's
+# timer ticks for each run, lower is better.
+
+MEM_MB=${1:-64}
+EXAMPLES=../examples
+
+if [ ! -x $EXAMPLES/matmult ]; then
+    echo "ERROR: build ../examples first"
+    exit 1
+fi
+
+for opt in "" "-nopse"; do
+
+    # add line spacing between runs
+    echo ""
+    echo "matmult: $MEM_MB MB RAM ${opt:-(4 MB pages)}"
+
+    cd build
+    pintos -v -k -T 300 -m $MEM_MB --filesys-size=2 --swap-size=4	\
+        -p ../$EXAMPLES/matmult -a matmult				\
+        -- -q $opt -f run matmult					\
+        2> /dev/null | grep -E "Timer:|matmult"
+    cd ..
+
+done
@@ -0,0 +1,48 @@
+#!/bin/bash
+
+# Page replacement benchmark: replays the paging workloads of tests/vm
+# under each replacement policy with user memory limited to UL pages.
+# Run from vm/ after `make`. Prints the kernel's timer ticks, fault,
+# eviction and swap counters of every run, so faults, swap I/O and
+# runtime can be compared between policies.
+
+UL=${1:-128}
+POLICIES=${POLICIES:-"clock esc 2q arc"}
+
+TESTS='
+page-linear:
+page-shuffle:
+page-parallel:child-linear
+page-merge-seq:child-sort
+page-merge-par:child-sort
+page-merge-stk:child-qsort
+page-merge-mm:child-qsort-mm
+mmap-shuffle:
+'
+
+cd build
+for policy in $POLICIES; do
+    for t in $TESTS; do
+        test=${t%%:*}
+        child=${t#*:}
+
+        if [ ! -x tests/vm/$test ]; then
+            echo "ERROR: build tests/vm/$test first"
+            exit 1
+        fi
+
+        PUT="-p tests/vm/$test -a $test"
+        if [ -n "$child" ]; then
+            PUT="$PUT -p tests/vm/$child -a $child"
+        fi
+
+        # add line spacing between runs
+        echo ""
+        echo "repl: $policy $test -ul=$UL"
+
+        pintos -v -k -T 600 --filesys-size=2 --swap-size=4 $PUT	\
+            -- -q -ul=$UL -repl=$policy -f run $test			\
+            2> /dev/null | grep -E "Timer:|VM:|Repl:|FAIL"
+    done
+done
+cd ..
@@ -1,23 +1,57 @@
 #include <bitmap.h>
+#include <list.h>
+#include <round.h>
 #include <stdio.h>
 #include "threads/vaddr.h"
 #include "devices/block.h"
+#include "threads/palloc.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
 #include "vm/swap.h"
 #include "vm/page.h"
 #include "vm/frame.h"
+#include "vm/zswap.h"
 
 static const size_t NUM_SECTORS = PGSIZE / BLOCK_SECTOR_SIZE;
 static size_t swap_space_size;
 static struct block *swap_disk;
 static struct bitmap *swap_map;
 
+// Number of slots reserved together for one process
+#define SWAP_CLUSTER 8
+
+// owner page of each slot, NULL if slot is free or shared after fork
+static struct spt_entry **swap_spte;
+
+// number of pages referring to each slot, the slot is free at zero
+static uint16_t *swap_refs;
+
+// next-fit cursor, searches for free clusters start here
+static size_t swap_cursor;
+
 struct lock swap_lock;
 
+// pending swap-out requests, serviced in order by the writeback thread
+static struct list wb_queue;
+static struct lock wb_lock;
+static struct semaphore wb_pending;
+
 void swap_init (void);
 void swap_free (uint32_t swap_idx);
 void swap_get (uint32_t swap_idx, void *page);
 uint32_t swap_put (void *page);
+uint32_t swap_alloc (struct spt_entry *spte);
+void swap_dup (uint32_t swap_idx);
+struct spt_entry *swap_lookup (uint32_t swap_idx, struct thread *owner);
+void swap_write (uint32_t swap_idx, void *page);
+void swap_put_async (struct swap_req *req, void *page, uint32_t swap_idx);
+void swap_wait (struct swap_req *req);
+size_t swap_slot_cnt (void);
+bool swap_full (void);
+void swap_oom_score (void);
+
+static void swap_writeback (void *aux);
+static size_t swap_scan (size_t cnt);
 
 /**
  * Purpose:
@@ -45,8 +79,28 @@ swap_init (void)
   //Set all elements in bitmap to available
   bitmap_set_all(swap_map, true);
 
-  // lock_init (&swap_lock);
-  
+  // Reverse map from slot to page, for readahead
+  swap_spte = palloc_get_multiple (PAL_ASSERT | PAL_ZERO,
+                                   DIV_ROUND_UP (swap_space_size
+                                                 * sizeof *swap_spte,
+                                                 PGSIZE));
+  swap_refs = palloc_get_multiple (PAL_ASSERT | PAL_ZERO,
+                                   DIV_ROUND_UP (swap_space_size
+                                                 * sizeof *swap_refs,
+                                                 PGSIZE));
+  swap_cursor = 0;
+
+  lock_init (&swap_lock);
+
+  // Compressed tier in front of the swap disk
+  zswap_init (swap_space_size);
+
+  // Start writeback thread for asynchronous swap-out
+  list_init (&wb_queue);
+  lock_init (&wb_lock);
+  sema_init (&wb_pending, 0);
+  thread_create ("swap-writeback", PRI_DEFAULT, swap_writeback, NULL);
+
   return;
 }
 
@@ -54,6 +108,7 @@ swap_init (void)
  * Purpose:
  *  Frees page to be written to (for when closing down and resetting 
  *   swap space)
+ *    * drops one reference, the slot is freed with the last one
  * 
  * Args:
  *  uint32_t swap_idx the index in the swap table to set
@@ -64,8 +119,8 @@ swap_init (void)
 void
 swap_free (uint32_t swap_idx){
 
-  // lock_acquire (&swap_lock);
-  
+  lock_acquire (&swap_lock);
+
   // printf("free swap index %d\n", swap_idx);
 
   //validate index
@@ -76,10 +131,15 @@ swap_free (uint32_t swap_idx){
   //fails if index is still available
   // ASSERT (!bitmap_test(swap_map, swap_idx));
   
-  //set index to available
-  bitmap_set(swap_map, swap_idx, true);
+  //set index to available once no page refers to it
+  swap_spte[swap_idx] = NULL;
+  if (swap_refs[swap_idx] > 0 && --swap_refs[swap_idx] == 0)
+  {
+    bitmap_set(swap_map, swap_idx, true);
+    zswap_invalidate (swap_idx);
+  }
 
-  // lock_release (&swap_lock);
+  lock_release (&swap_lock);
 
   return;
 }
@@ -100,10 +160,16 @@ swap_get (uint32_t swap_idx, void *page){
 
   // printf("get page %p from swap index %d!\n", page, swap_idx);
 
-  // lock_acquire (&swap_lock);
-
   //fails if index is still available
+  lock_acquire (&swap_lock);
   ASSERT (!bitmap_test(swap_map, swap_idx));
+  lock_release (&swap_lock);
+
+  // compressed tier hit, no disk read
+  if (zswap_load (swap_idx, page))
+  {
+    return;
+  }
 
   uint32_t sector;
   for (sector = 0; sector < NUM_SECTORS; ++sector) {
@@ -114,10 +180,8 @@ swap_get (uint32_t swap_idx, void *page){
         );
   }
 
-  //set written block sector bit to accessed in swap table
-  bitmap_set(swap_map, swap_idx, true);
-
-  // lock_release (&swap_lock);
+  // slot stays reserved until `swap_free`, so it can't be handed to
+  // another page between the read and the free
 
   return;
 }
@@ -130,27 +194,345 @@ swap_get (uint32_t swap_idx, void *page){
  *  None
  * 
  * Returns:
- *  {uint32_t} Swap index of page
+ *  {uint32_t} Swap index of page, BITMAP_ERROR if swap is full
  */ 
 uint32_t
 swap_put (void *page){
-  printf("problem page = %p\n", page);
   //get the next available swap slot by scanning bitmap
-  uint32_t swap_index = bitmap_scan (swap_map, 0, 1, true);
+  uint32_t swap_index = swap_alloc (NULL);
+  if (swap_index == BITMAP_ERROR)
+  {
+    return swap_index;
+  }
+
+  if (!zswap_store (swap_index, page))
+  {
+    swap_write (swap_index, page);
+  }
+
+  return swap_index;
+}
+
+/**
+ * Purpose:
+ *  Reserves a free swap slot without writing to it
+ *    * slots of one process are handed out from a cluster of
+ *      `SWAP_CLUSTER` contiguous slots, so pages evicted together
+ *      sit next to each other on disk
+ *    * new clusters are found next-fit from `swap_cursor`
+ *
+ * Args:
+ *  spte {spt_entry*} Page that will be written to the slot, NULL if
+ *                    the slot has no owner page
+ *
+ * Returns:
+ *  {uint32_t} Swap index of reserved slot, BITMAP_ERROR if swap is full
+ */
+uint32_t
+swap_alloc (struct spt_entry *spte)
+{
+  struct thread *t = spte != NULL ? spte->owner : NULL;
+  size_t swap_index;
+
+  lock_acquire (&swap_lock);
+
+  if (t != NULL && t->swap_left > 0 && t->swap_next < swap_space_size
+      && bitmap_test (swap_map, t->swap_next))
+  {
+    // continue owner's cluster
+    swap_index = t->swap_next;
+  }
+  else
+  {
+    // start new cluster, or settle for a lone slot when swap is fragmented
+    size_t cnt = SWAP_CLUSTER;
+    swap_index = swap_scan (cnt);
+    if (swap_index == BITMAP_ERROR)
+    {
+      cnt = 1;
+      swap_index = swap_scan (cnt);
+    }
+
+    if (t != NULL)
+    {
+      t->swap_left = cnt;
+    }
+  }
+
+  if (swap_index != BITMAP_ERROR)
+  {
+    bitmap_set (swap_map, swap_index, false);
+    swap_spte[swap_index] = spte;
+    swap_refs[swap_index] = 1;
+
+    if (t != NULL)
+    {
+      t->swap_next = swap_index + 1;
+      t->swap_left--;
+    }
+  }
+
+  lock_release (&swap_lock);
+
+  return swap_index;
+}
+
+/**
+ * Purpose:
+ *  Adds a reference to a used slot, for a page shared after fork
+ *    * a shared slot has no single owner page, so it is left out of
+ *      readahead
+ *
+ * Args:
+ *  swap_idx {uint32_t} Swap index
+ *
+ * Returns:
+ *  None
+ */
+void
+swap_dup (uint32_t swap_idx)
+{
+  lock_acquire (&swap_lock);
+
+  ASSERT (swap_idx < swap_space_size);
+  ASSERT (!bitmap_test (swap_map, swap_idx));
+
+  swap_refs[swap_idx]++;
+  swap_spte[swap_idx] = NULL;
+
+  lock_release (&swap_lock);
+}
+
+/**
+ * Purpose:
+ *  Next-fit search for a run of free slots
+ *    * must be called with `swap_lock` held
+ *
+ * Args:
+ *  cnt {size_t} Number of contiguous free slots wanted
+ *
+ * Returns:
+ *  {size_t} First slot of run, BITMAP_ERROR if none
+ */
+static size_t
+swap_scan (size_t cnt)
+{
+  size_t idx = bitmap_scan (swap_map, swap_cursor, cnt, true);
+  if (idx == BITMAP_ERROR && swap_cursor != 0)
+  {
+    // wrap around
+    idx = bitmap_scan (swap_map, 0, cnt, true);
+  }
+
+  if (idx != BITMAP_ERROR)
+  {
+    swap_cursor = (idx + cnt) % swap_space_size;
+  }
+
+  return idx;
+}
+
+/**
+ * Purpose:
+ *  Find a page of a process whose evicted copy is held in a swap slot
+ *    * ownership is checked under `swap_lock`, which `swap_free` takes
+ *      before an entry can be freed, so only the returned entry of the
+ *      caller's own process is ever touched
+ *
+ * Args:
+ *  swap_idx {uint32_t} Swap index
+ *  owner     {thread*} Process the page must belong to
+ *
+ * Returns:
+ *  {spt_entry*} Owner page of slot, NULL if slot is free, out of range,
+ *               shared or held by another process
+ */
+struct spt_entry *
+swap_lookup (uint32_t swap_idx, struct thread *owner)
+{
+  struct spt_entry *spte = NULL;
+
+  if (swap_idx < swap_space_size)
+  {
+    lock_acquire (&swap_lock);
+    spte = swap_spte[swap_idx];
+    if (spte != NULL
+        && (spte->owner != owner || spte->swap_index != (int) swap_idx))
+    {
+      spte = NULL;
+    }
+    lock_release (&swap_lock);
+  }
+
+  return spte;
+}
 
+/**
+ * Purpose:
+ *  Writes page to a reserved swap slot, synchronously
+ *
+ * Args:
+ *  swap_idx {uint32_t} Swap index returned by `swap_alloc`
+ *  page        {void*} Page to write
+ *
+ * Returns:
+ *  None
+ */
+void
+swap_write (uint32_t swap_idx, void *page)
+{
   uint32_t sector = 0;
   for (sector = 0; sector < NUM_SECTORS; sector++) {
     //write to swap block using the sector number and indexed target addr
-    block_write(swap_disk, swap_index * NUM_SECTORS + sector,
+    block_write(swap_disk, swap_idx * NUM_SECTORS + sector,
         page + (BLOCK_SECTOR_SIZE * sector)
         );
   }
 
-  //set written block sector bit to occupied in swap table
-  bitmap_set(swap_map, swap_index, false);
-  printf("put frame %p in swap index %d\n", page, swap_index);
-  return swap_index;
+  return;
+}
+
+/**
+ * Purpose:
+ *  Queues page for the writeback thread and returns immediately
+ *    * page must stay untouched until `swap_wait` returns
+ *
+ * Args:
+ *  req {swap_req*} Request storage, owned by caller until completion
+ *  page    {void*} Page to write
+ *  swap_idx {uint32_t} Swap index returned by `swap_alloc`
+ *
+ * Returns:
+ *  None
+ */
+void
+swap_put_async (struct swap_req *req, void *page, uint32_t swap_idx)
+{
+  req->page = page;
+  req->swap_idx = swap_idx;
+  sema_init (&req->done, 0);
+
+  lock_acquire (&wb_lock);
+  list_push_back (&wb_queue, &req->elem);
+  lock_release (&wb_lock);
+
+  sema_up (&wb_pending);
+
+  return;
+}
+
+/**
+ * Purpose:
+ *  Blocks until the writeback thread has finished a request
+ *
+ * Args:
+ *  req {swap_req*} Request passed to `swap_put_async`
+ *
+ * Returns:
+ *  None
+ */
+void
+swap_wait (struct swap_req *req)
+{
+  sema_down (&req->done);
+
+  return;
+}
+
+/**
+ * Purpose:
+ *  Writeback thread, completes queued swap-outs in order
+ *
+ * Args:
+ *  aux {void*} Unused
+ *
+ * Returns:
+ *  None
+ */
+static void
+swap_writeback (void *aux UNUSED)
+{
+  for (;;)
+  {
+    sema_down (&wb_pending);
+
+    lock_acquire (&wb_lock);
+    struct swap_req *req = list_entry (list_pop_front (&wb_queue),
+                                       struct swap_req, elem);
+    lock_release (&wb_lock);
+
+    // compressed tier first, disk only for pages it does not take
+    if (!zswap_store (req->swap_idx, req->page))
+    {
+      swap_write (req->swap_idx, req->page);
+    }
+
+    sema_up (&req->done);
+  }
 }
 
+/**
+ * Purpose:
+ *  Number of page slots on the swap disk
+ *
+ * Args:
+ *  None
+ *
+ * Returns:
+ *  {size_t} Swap slots
+ */
+size_t
+swap_slot_cnt (void)
+{
+  return swap_space_size;
+}
 
+/**
+ * Purpose:
+ *  Checks if every swap slot is in use
+ *    * evictions reserve their slot with `ft_lock` held, so the answer
+ *      holds until the caller releases it
+ *
+ * Args:
+ *  None
+ *
+ * Returns:
+ *  {bool} True if `swap_alloc` would fail
+ */
+bool
+swap_full (void)
+{
+  lock_acquire (&swap_lock);
+  bool full = !bitmap_contains (swap_map, 0, swap_space_size, true);
+  lock_release (&swap_lock);
+
+  return full;
+}
+
+/**
+ * Purpose:
+ *  Adds each process's swapped pages to its `oom_score`
+ *    * slots shared after fork have no owner and count for nobody,
+ *      killing one sharer would not free them
+ *
+ * Args:
+ *  None
+ *
+ * Returns:
+ *  None
+ */
+void
+swap_oom_score (void)
+{
+  size_t i;
 
+  lock_acquire (&swap_lock);
+  for (i = 0; i < swap_space_size; i++)
+  {
+    if (swap_spte[i] != NULL && swap_spte[i]->owner != NULL)
+    {
+      swap_spte[i]->owner->oom_score++;
+    }
+  }
+  lock_release (&swap_lock);
+}
@@ -1,4 +1,28 @@
+#ifndef VM_SWAP_H
+#define VM_SWAP_H
+
 #include "bitmap.h"
+#include <list.h>
+#include "threads/synch.h"
+
+struct spt_entry;
+struct thread;
+
+// swap-out request handed to the writeback thread
+struct swap_req
+{
+  // page being written
+  void *page;
+
+  // destination swap slot
+  uint32_t swap_idx;
+
+  // signalled once the page is on disk
+  struct semaphore done;
+
+  // list element in writeback queue
+  struct list_elem elem;
+};
 
 /**
  * Purpose:
@@ -46,6 +70,127 @@ void swap_get (uint32_t swap_idx, void *page);
  *  None
  * 
  * Returns:
- *  {uint32_t} Swap index of page
+ *  {uint32_t} Swap index of page, BITMAP_ERROR if swap is full
  */ 
 uint32_t swap_put (void *page);
+
+/**
+ * Purpose:
+ *  Reserves a free swap slot without writing to it
+ *    * slots of one process are clustered together on disk
+ *
+ * Args:
+ *  spte {spt_entry*} Page that will be written to the slot, NULL if
+ *                    the slot has no owner page
+ *
+ * Returns:
+ *  {uint32_t} Swap index of reserved slot, BITMAP_ERROR if swap is full
+ */
+uint32_t swap_alloc (struct spt_entry *spte);
+
+/**
+ * Purpose:
+ *  Adds a reference to a used slot, for a page shared after fork
+ *
+ * Args:
+ *  swap_idx {uint32_t} Swap index
+ *
+ * Returns:
+ *  None
+ */
+void swap_dup (uint32_t swap_idx);
+
+/**
+ * Purpose:
+ *  Find a page of a process whose evicted copy is held in a swap slot
+ *    * ownership is checked under `swap_lock`, which `swap_free` takes
+ *      before an entry can be freed, so only the returned entry of the
+ *      caller's own process is ever touched
+ *
+ * Args:
+ *  swap_idx {uint32_t} Swap index
+ *  owner     {thread*} Process the page must belong to
+ *
+ * Returns:
+ *  {spt_entry*} Owner page of slot, NULL if slot is free, out of range,
+ *               shared or held by another process
+ */
+struct spt_entry *swap_lookup (uint32_t swap_idx, struct thread *owner);
+
+/**
+ * Purpose:
+ *  Writes page to a reserved swap slot, synchronously
+ *
+ * Args:
+ *  swap_idx {uint32_t} Swap index returned by `swap_alloc`
+ *  page        {void*} Page to write
+ *
+ * Returns:
+ *  None
+ */
+void swap_write (uint32_t swap_idx, void *page);
+
+/**
+ * Purpose:
+ *  Queues page for the writeback thread and returns immediately
+ *    * page must stay untouched until `swap_wait` returns
+ *
+ * Args:
+ *  req {swap_req*} Request storage, owned by caller until completion
+ *  page    {void*} Page to write
+ *  swap_idx {uint32_t} Swap index returned by `swap_alloc`
+ *
+ * Returns:
+ *  None
+ */
+void swap_put_async (struct swap_req *req, void *page, uint32_t swap_idx);
+
+/**
+ * Purpose:
+ *  Blocks until the writeback thread has finished a request
+ *
+ * Args:
+ *  req {swap_req*} Request passed to `swap_put_async`
+ *
+ * Returns:
+ *  None
+ */
+void swap_wait (struct swap_req *req);
+
+/**
+ * Purpose:
+ *  Number of page slots on the swap disk
+ *
+ * Args:
+ *  None
+ *
+ * Returns:
+ *  {size_t} Swap slots
+ */
+size_t swap_slot_cnt (void);
+
+/**
+ * Purpose:
+ *  Checks if every swap slot is in use
+ *
+ * Args:
+ *  None
+ *
+ * Returns:
+ *  {bool} True if `swap_alloc` would fail
+ */
+bool swap_full (void);
+
+/**
+ * Purpose:
+ *  Adds each process's swapped pages to its `oom_score`
+ *
+ * Args:
+ *  None
+ *
+ * Returns:
+ *  None
+ */
+void swap_oom_score (void);
+
+#endif /* vm/swap.h */
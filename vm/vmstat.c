@@ -0,0 +1,381 @@
+#include <debug.h>
+#include <inttypes.h>
+#include <round.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "threads/interrupt.h"
+#include "threads/palloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "vm/vmstat.h"
+
+// trace entry flags
+#define TRACE_WRITE 1
+#define TRACE_USER 2
+
+// one traced page fault
+struct trace_entry
+{
+  int64_t tick;
+  const void *addr;
+  tid_t tid;
+  int flags;
+};
+
+size_t vmstat_trace_len;
+
+// system-wide counters
+static struct vmstat vm_total;
+
+// ring buffer of the last `vmstat_trace_len` faults, NULL if disabled
+static struct trace_entry *trace_buf;
+
+// faults traced so far, the next entry goes to `trace_cnt % len`
+static long long trace_cnt;
+
+void vmstat_init (void);
+void vmstat_count (struct thread *t, enum vmstat_event event);
+uint64_t vmstat_clock (void);
+void vmstat_swap_in (struct thread *t, uint64_t start);
+void vmstat_swap_out (struct thread *t, uint64_t start);
+void vmstat_trace (const void *addr, bool write, bool user);
+void vmstat_read (struct thread *t, struct vmstat *st);
+void vmstat_print_stats (void);
+
+static void count_event (struct vmstat *st, enum vmstat_event event);
+static size_t hist_bucket (uint64_t cycles);
+static void print_hist (const char *name, const long long *hist);
+
+/**
+ * Purpose:
+ *  Allocates the page-fault trace buffer if tracing is enabled
+ *
+ * Args:
+ *  None
+ *
+ * Returns:
+ *  None
+ */
+void
+vmstat_init (void)
+{
+  if (vmstat_trace_len == 0)
+  {
+    return;
+  }
+
+  trace_buf = palloc_get_multiple (PAL_ZERO,
+                                   DIV_ROUND_UP (vmstat_trace_len
+                                                 * sizeof *trace_buf,
+                                                 PGSIZE));
+  if (trace_buf == NULL)
+  {
+    printf ("VM: no memory for %zu trace entries, tracing disabled\n",
+            vmstat_trace_len);
+    vmstat_trace_len = 0;
+  }
+}
+
+/**
+ * Purpose:
+ *  Bumps the counter of an event in one set of counters
+ *
+ * Args:
+ *  st    {vmstat*} Counters
+ *  event {vmstat_event} Event
+ *
+ * Returns:
+ *  None
+ */
+static void
+count_event (struct vmstat *st, enum vmstat_event event)
+{
+  switch (event)
+  {
+    case VMSTAT_MINOR:
+      st->minor_faults++;
+      break;
+    case VMSTAT_MAJOR:
+      st->major_faults++;
+      break;
+    case VMSTAT_STACK:
+      st->stack_faults++;
+      break;
+    case VMSTAT_EVICT_CLEAN:
+      st->evict_clean++;
+      break;
+    case VMSTAT_EVICT_DIRTY:
+      st->evict_dirty++;
+      break;
+    case VMSTAT_PIN_STALL:
+      st->pin_stalls++;
+      break;
+  }
+}
+
+/**
+ * Purpose:
+ *  Counts an event for a process and for the system
+ *    * counters are 64 bits wide, interrupts are off while they are
+ *      updated so a preempting thread can't lose an update
+ *
+ * Args:
+ *  t     {thread*} Process the event is charged to, NULL for none
+ *  event {vmstat_event} Event
+ *
+ * Returns:
+ *  None
+ */
+void
+vmstat_count (struct thread *t, enum vmstat_event event)
+{
+  enum intr_level old_level = intr_disable ();
+
+  count_event (&vm_total, event);
+  if (t != NULL)
+  {
+    count_event (&t->vmstat, event);
+  }
+
+  intr_set_level (old_level);
+}
+
+/**
+ * Purpose:
+ *  Reads the cycle counter, the start time of a timed swap operation
+ *
+ * Args:
+ *  None
+ *
+ * Returns:
+ *  {uint64_t} Current CPU cycle count
+ */
+uint64_t
+vmstat_clock (void)
+{
+  uint64_t tsc;
+
+  asm volatile ("rdtsc" : "=A" (tsc));
+
+  return tsc;
+}
+
+/**
+ * Purpose:
+ *  Histogram bucket of a latency
+ *
+ * Args:
+ *  cycles {uint64_t} Latency in CPU cycles
+ *
+ * Returns:
+ *  {size_t} Bucket index
+ */
+static size_t
+hist_bucket (uint64_t cycles)
+{
+  size_t bucket = 0;
+
+  cycles >>= VMSTAT_HIST_SHIFT;
+  while (cycles > 0 && bucket < VMSTAT_HIST_BUCKETS - 1)
+  {
+    cycles >>= 1;
+    bucket++;
+  }
+
+  return bucket;
+}
+
+/**
+ * Purpose:
+ *  Counts a finished swap-in and its latency
+ *
+ * Args:
+ *  t     {thread*} Process the page belongs to, NULL for none
+ *  start {uint64_t} `vmstat_clock` before the swap-in began
+ *
+ * Returns:
+ *  None
+ */
+void
+vmstat_swap_in (struct thread *t, uint64_t start)
+{
+  size_t bucket = hist_bucket (vmstat_clock () - start);
+  enum intr_level old_level = intr_disable ();
+
+  vm_total.swap_ins++;
+  vm_total.swap_in_hist[bucket]++;
+  if (t != NULL)
+  {
+    t->vmstat.swap_ins++;
+    t->vmstat.swap_in_hist[bucket]++;
+  }
+
+  intr_set_level (old_level);
+}
+
+/**
+ * Purpose:
+ *  Counts a finished swap-out and its latency
+ *
+ * Args:
+ *  t     {thread*} Process the page belonged to, NULL for none
+ *  start {uint64_t} `vmstat_clock` before the swap-out began
+ *
+ * Returns:
+ *  None
+ */
+void
+vmstat_swap_out (struct thread *t, uint64_t start)
+{
+  size_t bucket = hist_bucket (vmstat_clock () - start);
+  enum intr_level old_level = intr_disable ();
+
+  vm_total.swap_outs++;
+  vm_total.swap_out_hist[bucket]++;
+  if (t != NULL)
+  {
+    t->vmstat.swap_outs++;
+    t->vmstat.swap_out_hist[bucket]++;
+  }
+
+  intr_set_level (old_level);
+}
+
+/**
+ * Purpose:
+ *  Records a page fault of the current thread in the trace buffer,
+ *  overwriting the oldest entry once it is full
+ *
+ * Args:
+ *  addr {void*} Fault address
+ *  write {bool} True if the access was a write
+ *  user  {bool} True if the fault came from user mode
+ *
+ * Returns:
+ *  None
+ */
+void
+vmstat_trace (const void *addr, bool write, bool user)
+{
+  if (trace_buf == NULL)
+  {
+    return;
+  }
+
+  enum intr_level old_level = intr_disable ();
+
+  struct trace_entry *e = &trace_buf[trace_cnt % vmstat_trace_len];
+  e->tick = timer_ticks ();
+  e->addr = addr;
+  e->tid = thread_current ()->tid;
+  e->flags = (write ? TRACE_WRITE : 0) | (user ? TRACE_USER : 0);
+  trace_cnt++;
+
+  intr_set_level (old_level);
+}
+
+/**
+ * Purpose:
+ *  Copies the counters of a process or of the system
+ *
+ * Args:
+ *  t  {thread*} Process, NULL for the system-wide counters
+ *  st {vmstat*} Destination
+ *
+ * Returns:
+ *  None
+ */
+void
+vmstat_read (struct thread *t, struct vmstat *st)
+{
+  enum intr_level old_level = intr_disable ();
+
+  *st = t != NULL ? t->vmstat : vm_total;
+
+  intr_set_level (old_level);
+}
+
+/**
+ * Purpose:
+ *  Prints the non-empty buckets of a latency histogram on one line
+ *
+ * Args:
+ *  name {char*} Operation name
+ *  hist {long long*} Histogram
+ *
+ * Returns:
+ *  None
+ */
+static void
+print_hist (const char *name, const long long *hist)
+{
+  size_t i;
+
+  printf ("VM: %s latency:", name);
+  for (i = 0; i < VMSTAT_HIST_BUCKETS; i++)
+  {
+    if (hist[i] == 0)
+    {
+      continue;
+    }
+
+    if (i < VMSTAT_HIST_BUCKETS - 1)
+    {
+      printf (" <%uk cycles %lld,", 1u << i, hist[i]);
+    }
+    else
+    {
+      printf (" >=%uk cycles %lld,", 1u << (i - 1), hist[i]);
+    }
+  }
+  printf ("\n");
+}
+
+/**
+ * Purpose:
+ *  Prints system-wide counters and the fault trace at shutdown
+ *
+ * Args:
+ *  None
+ *
+ * Returns:
+ *  None
+ */
+void
+vmstat_print_stats (void)
+{
+  printf ("VM: %lld minor faults, %lld major, %lld stack growth\n",
+          vm_total.minor_faults, vm_total.major_faults,
+          vm_total.stack_faults);
+  printf ("VM: %lld evictions, %lld clean, %lld bytes of swap writes saved\n",
+          vm_total.evict_clean + vm_total.evict_dirty, vm_total.evict_clean,
+          vm_total.evict_clean * PGSIZE);
+  printf ("VM: %lld swap-ins, %lld swap-outs, %lld pinned page stalls\n",
+          vm_total.swap_ins, vm_total.swap_outs, vm_total.pin_stalls);
+  if (vm_total.swap_ins > 0)
+  {
+    print_hist ("swap-in", vm_total.swap_in_hist);
+  }
+  if (vm_total.swap_outs > 0)
+  {
+    print_hist ("swap-out", vm_total.swap_out_hist);
+  }
+
+  if (trace_buf != NULL)
+  {
+    long long first = trace_cnt > (long long) vmstat_trace_len
+                      ? trace_cnt - (long long) vmstat_trace_len : 0;
+    long long i;
+
+    printf ("VM: last %lld of %lld page faults:\n", trace_cnt - first,
+            trace_cnt);
+    for (i = first; i < trace_cnt; i++)
+    {
+      struct trace_entry *e = &trace_buf[i % vmstat_trace_len];
+      printf ("VM:   tick %"PRId64" tid %d %p %s %s\n", e->tick, e->tid,
+              e->addr, e->flags & TRACE_WRITE ? "write" : "read",
+              e->flags & TRACE_USER ? "user" : "kernel");
+    }
+  }
+}
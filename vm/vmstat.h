@@ -0,0 +1,127 @@
+#ifndef VM_VMSTAT_H
+#define VM_VMSTAT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <vmstat.h>
+
+struct thread;
+
+// Page-fault trace entries kept, set by `-vmtrace=N`, 0 disables tracing
+extern size_t vmstat_trace_len;
+
+// counted virtual memory events, see `struct vmstat`
+enum vmstat_event
+{
+  VMSTAT_MINOR,
+  VMSTAT_MAJOR,
+  VMSTAT_STACK,
+  VMSTAT_EVICT_CLEAN,
+  VMSTAT_EVICT_DIRTY,
+  VMSTAT_PIN_STALL
+};
+
+/**
+ * Purpose:
+ *  Allocates the page-fault trace buffer if tracing is enabled
+ *
+ * Args:
+ *  None
+ *
+ * Returns:
+ *  None
+ */
+void vmstat_init (void);
+
+/**
+ * Purpose:
+ *  Counts an event for a process and for the system
+ *
+ * Args:
+ *  t     {thread*} Process the event is charged to, NULL for none
+ *  event {vmstat_event} Event
+ *
+ * Returns:
+ *  None
+ */
+void vmstat_count (struct thread *t, enum vmstat_event event);
+
+/**
+ * Purpose:
+ *  Reads the cycle counter, the start time of a timed swap operation
+ *
+ * Args:
+ *  None
+ *
+ * Returns:
+ *  {uint64_t} Current CPU cycle count
+ */
+uint64_t vmstat_clock (void);
+
+/**
+ * Purpose:
+ *  Counts a finished swap-in and its latency
+ *
+ * Args:
+ *  t     {thread*} Process the page belongs to, NULL for none
+ *  start {uint64_t} `vmstat_clock` before the swap-in began
+ *
+ * Returns:
+ *  None
+ */
+void vmstat_swap_in (struct thread *t, uint64_t start);
+
+/**
+ * Purpose:
+ *  Counts a finished swap-out and its latency
+ *
+ * Args:
+ *  t     {thread*} Process the page belonged to, NULL for none
+ *  start {uint64_t} `vmstat_clock` before the swap-out began
+ *
+ * Returns:
+ *  None
+ */
+void vmstat_swap_out (struct thread *t, uint64_t start);
+
+/**
+ * Purpose:
+ *  Records a page fault of the current thread in the trace buffer
+ *
+ * Args:
+ *  addr {void*} Fault address
+ *  write {bool} True if the access was a write
+ *  user  {bool} True if the fault came from user mode
+ *
+ * Returns:
+ *  None
+ */
+void vmstat_trace (const void *addr, bool write, bool user);
+
+/**
+ * Purpose:
+ *  Copies the counters of a process or of the system
+ *
+ * Args:
+ *  t  {thread*} Process, NULL for the system-wide counters
+ *  st {vmstat*} Destination
+ *
+ * Returns:
+ *  None
+ */
+void vmstat_read (struct thread *t, struct vmstat *st);
+
+/**
+ * Purpose:
+ *  Prints system-wide counters and the fault trace at shutdown
+ *
+ * Args:
+ *  None
+ *
+ * Returns:
+ *  None
+ */
+void vmstat_print_stats (void);
+
+#endif /* vm/vmstat.h */
@@ -0,0 +1,255 @@
+#include <debug.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "devices/timer.h"
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "vm/frame.h"
+#include "vm/ws.h"
+
+// Ticks between two samples of the accessed bits
+#define WS_INTERVAL 25
+
+// Page-fault frequency bounds in faults per second, above PFF_HIGH a
+// process gets QUOTA_STEP more frames than its working set, below PFF_LOW
+// it gives QUOTA_STEP back
+#define PFF_HIGH 40
+#define PFF_LOW 10
+#define QUOTA_STEP 8
+
+// System-wide fault rate above which a working set overcommit is thrashing
+#define LC_FAULT_RATE 200
+
+bool ws_load_control;
+
+// demand seen by one sampling pass
+struct ws_totals
+{
+  // sum of the working sets of processes that are not suspended
+  size_t active_ws;
+
+  // number of processes that are not suspended
+  int active_cnt;
+
+  // faults per second over all processes
+  int fault_rate;
+
+  // largest active process, next to suspend
+  struct thread *largest;
+
+  // suspended process with the smallest working set, next to resume
+  struct thread *smallest;
+};
+
+// Load control counters
+static long long suspend_cnt;
+static long long resume_cnt;
+
+void ws_init (void);
+void ws_wait_resume (void);
+void ws_print_stats (void);
+
+static void ws_sampler (void *aux);
+static void ws_publish (struct thread *t, void *aux);
+static void ws_load_balance (struct ws_totals *totals);
+
+/**
+ * Purpose:
+ *  Starts the working set sampler, which estimates per-process working
+ *  sets and page-fault frequency and adjusts frame quotas
+ *    * must be called after `init_frame()` and `thread_start()`
+ *
+ * Args:
+ *  None
+ *
+ * Returns:
+ *  None
+ */
+void
+ws_init (void)
+{
+  thread_create ("vm-sampler", PRI_DEFAULT, ws_sampler, NULL);
+
+  return;
+}
+
+/**
+ * Purpose:
+ *  Blocks the current process while load control keeps it suspended
+ *
+ * Args:
+ *  None
+ *
+ * Returns:
+ *  None
+ */
+void
+ws_wait_resume (void)
+{
+  struct thread *cur = thread_current ();
+
+  // a process picked by the OOM killer is let go so it can exit
+  while (cur->vm_suspended && !cur->oom_killed)
+  {
+    sema_down (&cur->vm_resume);
+  }
+
+  return;
+}
+
+/**
+ * Purpose:
+ *  Prints working set statistics at shutdown
+ *
+ * Args:
+ *  None
+ *
+ * Returns:
+ *  None
+ */
+void
+ws_print_stats (void)
+{
+  if (ws_load_control)
+  {
+    printf ("WS: %lld suspensions, %lld resumes\n", suspend_cnt, resume_cnt);
+  }
+}
+
+/**
+ * Purpose:
+ *  Sampler thread, every `WS_INTERVAL` ticks collects the accessed bits
+ *  and turns them into working sets, fault rates and frame quotas
+ *
+ * Args:
+ *  aux {void*} Unused
+ *
+ * Returns:
+ *  None
+ */
+static void
+ws_sampler (void *aux UNUSED)
+{
+  for (;;)
+  {
+    timer_sleep (WS_INTERVAL);
+
+    frame_sample ();
+
+    struct ws_totals totals = { 0, 0, 0, NULL, NULL };
+
+    // the counters are also written by faulting processes, publish them
+    // in one step
+    enum intr_level old_level = intr_disable ();
+    thread_foreach (ws_publish, &totals);
+    if (ws_load_control)
+    {
+      ws_load_balance (&totals);
+    }
+    intr_set_level (old_level);
+  }
+}
+
+/**
+ * Purpose:
+ *  Publishes one sampling interval of a process and updates its quota
+ *  from its page-fault frequency, called with interrupts off
+ *    * a suspended process keeps the working set it had when suspended,
+ *      it is what it needs to run again
+ *
+ * Args:
+ *  t   {thread*} Thread
+ *  aux   {void*} Totals of the pass, `struct ws_totals`
+ *
+ * Returns:
+ *  None
+ */
+static void
+ws_publish (struct thread *t, void *aux)
+{
+  struct ws_totals *totals = aux;
+
+  if (t->pagedir == NULL || t->spt == NULL)
+  {
+    // kernel thread
+    return;
+  }
+
+  t->ws_resident = t->ws_resident_acc;
+  t->fault_rate = t->fault_cnt * TIMER_FREQ / WS_INTERVAL;
+  t->ws_resident_acc = 0;
+  t->fault_cnt = 0;
+
+  if (t->vm_suspended)
+  {
+    t->ws_acc = 0;
+    if (totals->smallest == NULL || t->ws_size < totals->smallest->ws_size)
+    {
+      totals->smallest = t;
+    }
+    return;
+  }
+
+  t->ws_size = t->ws_acc;
+  t->ws_acc = 0;
+
+  // page-fault frequency, grant frames above the working set to a process
+  // that keeps faulting and take them back once it settles
+  if (t->fault_rate > PFF_HIGH)
+  {
+    t->ws_slack += QUOTA_STEP;
+  }
+  else if (t->fault_rate < PFF_LOW && t->ws_slack >= QUOTA_STEP)
+  {
+    t->ws_slack -= QUOTA_STEP;
+  }
+  t->frame_quota = t->ws_size + t->ws_slack;
+
+  totals->active_ws += t->ws_size;
+  totals->active_cnt++;
+  totals->fault_rate += t->fault_rate;
+  if (totals->largest == NULL || t->ws_size > totals->largest->ws_size)
+  {
+    totals->largest = t;
+  }
+}
+
+/**
+ * Purpose:
+ *  Load control, suspends the largest process while the working sets of
+ *  the running ones overcommit memory and the system keeps faulting, and
+ *  resumes a suspended one once its working set fits again
+ *    * at most one process changes state per interval
+ *
+ * Args:
+ *  totals {ws_totals*} Totals of the pass
+ *
+ * Returns:
+ *  None
+ */
+static void
+ws_load_balance (struct ws_totals *totals)
+{
+  size_t frames = frame_total_cnt ();
+
+  if (totals->fault_rate > LC_FAULT_RATE && totals->active_ws > frames
+      && totals->active_cnt > 1)
+  {
+    // thrashing, its frames go first once its quota is zero
+    struct thread *t = totals->largest;
+    t->vm_suspended = true;
+    t->frame_quota = 0;
+    suspend_cnt++;
+  }
+  else if (totals->smallest != NULL
+           && (totals->active_cnt == 0
+               || totals->active_ws + totals->smallest->ws_size <= frames))
+  {
+    struct thread *t = totals->smallest;
+    t->vm_suspended = false;
+    t->frame_quota = t->ws_size + t->ws_slack;
+    sema_up (&t->vm_resume);
+    resume_cnt++;
+  }
+}
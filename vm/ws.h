@@ -0,0 +1,46 @@
+#ifndef VM_WS_H
+#define VM_WS_H
+
+#include <stdbool.h>
+
+// Suspends processes while the system thrashes, set by `-lc`
+extern bool ws_load_control;
+
+/**
+ * Purpose:
+ *  Starts the working set sampler, which estimates per-process working
+ *  sets and page-fault frequency and adjusts frame quotas
+ *
+ * Args:
+ *  None
+ *
+ * Returns:
+ *  None
+ */
+void ws_init (void);
+
+/**
+ * Purpose:
+ *  Blocks the current process while load control keeps it suspended
+ *
+ * Args:
+ *  None
+ *
+ * Returns:
+ *  None
+ */
+void ws_wait_resume (void);
+
+/**
+ * Purpose:
+ *  Prints working set statistics at shutdown
+ *
+ * Args:
+ *  None
+ *
+ * Returns:
+ *  None
+ */
+void ws_print_stats (void);
+
+#endif /* vm/ws.h */
@@ -0,0 +1,503 @@
+#include <list.h>
+#include <round.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+#include "vm/swap.h"
+#include "vm/zswap.h"
+
+// Largest compressed page kept in RAM, anything bigger goes to disk
+#define ZSWAP_MAX_LEN (PGSIZE * 3 / 4)
+
+// LZ codec tokens: a control byte below LZ_MAX_LITERAL is followed by
+// that many plus one literal bytes, any other control byte is a match of
+// (byte & 0x7f) + LZ_MIN_MATCH bytes followed by a 2 byte back offset
+#define LZ_MIN_MATCH 3
+#define LZ_MAX_MATCH (LZ_MIN_MATCH + 0x7f)
+#define LZ_MAX_LITERAL 0x80
+#define LZ_HASH_BITS 12
+
+// compressed copy of one swapped out page
+struct zswap_entry
+{
+  // swap slot the page belongs to
+  uint32_t swap_idx;
+
+  // compressed length, 0 for an all-zero page
+  size_t len;
+
+  // list element in `z_fifo`
+  struct list_elem elem;
+
+  // compressed page
+  uint8_t data[];
+};
+
+size_t zswap_max_pages = 64;
+
+// compressed copy of each slot, NULL if the slot's page is on disk
+static struct zswap_entry **z_table;
+
+// compressed pages, oldest first, the front is spilled to disk first
+static struct list z_fifo;
+
+// bytes held by the tier and the most it may hold
+static size_t z_bytes;
+static size_t z_budget;
+
+// protects the tier and the scratch buffers below
+static struct lock z_lock;
+
+// scratch buffers, compressed output and decompressed spill page
+static uint8_t z_buf[ZSWAP_MAX_LEN];
+static uint8_t z_page[PGSIZE];
+
+// LZ match finder, last position + 1 of each 3 byte hash
+static uint16_t lz_table[1 << LZ_HASH_BITS];
+
+// Tier counters
+static long long z_store_cnt;
+static long long z_zero_cnt;
+static long long z_reject_cnt;
+static long long z_spill_cnt;
+static long long z_hit_cnt;
+static long long z_miss_cnt;
+static long long z_in_bytes;
+static long long z_out_bytes;
+
+void zswap_init (size_t slot_cnt);
+bool zswap_store (uint32_t swap_idx, const void *page);
+bool zswap_load (uint32_t swap_idx, void *page);
+void zswap_invalidate (uint32_t swap_idx);
+void zswap_print_stats (void);
+
+static void spill_oldest (void);
+static void drop_entry (struct zswap_entry *e);
+static bool is_zero_page (const void *page);
+static size_t lz_compress (const uint8_t *src, uint8_t *dst, size_t max);
+static bool lz_literals (const uint8_t *lit, size_t n, uint8_t *dst,
+                         size_t *op, size_t max);
+static void lz_decompress (const uint8_t *src, size_t len, uint8_t *dst);
+static uint32_t lz_hash (const uint8_t *p);
+
+/**
+ * Purpose:
+ *  Initializes the compressed swap tier
+ *    * must be called after `malloc_init()`
+ *
+ * Args:
+ *  slot_cnt {size_t} Number of swap slots on the swap device
+ *
+ * Returns:
+ *  None
+ */
+void
+zswap_init (size_t slot_cnt)
+{
+  z_table = palloc_get_multiple (PAL_ASSERT | PAL_ZERO,
+                                 DIV_ROUND_UP (slot_cnt * sizeof *z_table,
+                                               PGSIZE));
+  list_init (&z_fifo);
+  lock_init (&z_lock);
+
+  z_bytes = 0;
+  z_budget = zswap_max_pages * PGSIZE;
+
+  return;
+}
+
+/**
+ * Purpose:
+ *  Stores page for a swap slot in compressed form, in RAM
+ *    * all-zero pages take no data, pages that do not shrink to
+ *      `ZSWAP_MAX_LEN` are left for the disk
+ *    * when the tier is full, its oldest pages are spilled to disk
+ *
+ * Args:
+ *  swap_idx {uint32_t} Swap slot reserved for the page
+ *  page        {void*} Page to store
+ *
+ * Returns:
+ *  {bool} True if stored, false if the page must be written to disk
+ */
+bool
+zswap_store (uint32_t swap_idx, const void *page)
+{
+  bool stored = false;
+
+  if (z_budget == 0)
+  {
+    return false;
+  }
+
+  lock_acquire (&z_lock);
+
+  ASSERT (z_table[swap_idx] == NULL);
+
+  bool zero = is_zero_page (page);
+  size_t len = zero ? 0 : lz_compress (page, z_buf, ZSWAP_MAX_LEN);
+
+  if (!zero && len == 0)
+  {
+    // incompressible, not worth the RAM
+    z_reject_cnt++;
+  }
+  else
+  {
+    size_t size = sizeof (struct zswap_entry) + len;
+    while (z_bytes + size > z_budget && !list_empty (&z_fifo))
+    {
+      spill_oldest ();
+    }
+
+    struct zswap_entry *e = NULL;
+    if (z_bytes + size <= z_budget)
+    {
+      e = malloc (size);
+    }
+
+    if (e != NULL)
+    {
+      e->swap_idx = swap_idx;
+      e->len = len;
+      memcpy (e->data, z_buf, len);
+      list_push_back (&z_fifo, &e->elem);
+      z_table[swap_idx] = e;
+      z_bytes += size;
+
+      z_store_cnt++;
+      z_zero_cnt += zero;
+      z_in_bytes += PGSIZE;
+      z_out_bytes += len;
+      stored = true;
+    }
+  }
+
+  lock_release (&z_lock);
+
+  return stored;
+}
+
+/**
+ * Purpose:
+ *  Reads page of a swap slot back from the compressed tier
+ *    * the compressed copy stays until the slot is freed, so a slot
+ *      shared after fork can be read by each sharer
+ *
+ * Args:
+ *  swap_idx {uint32_t} Swap slot
+ *  page        {void*} Destination page
+ *
+ * Returns:
+ *  {bool} True on a hit, false if the slot's page is on disk
+ */
+bool
+zswap_load (uint32_t swap_idx, void *page)
+{
+  lock_acquire (&z_lock);
+
+  struct zswap_entry *e = z_table[swap_idx];
+  if (e != NULL)
+  {
+    lz_decompress (e->data, e->len, page);
+    z_hit_cnt++;
+  }
+  else
+  {
+    z_miss_cnt++;
+  }
+
+  lock_release (&z_lock);
+
+  return e != NULL;
+}
+
+/**
+ * Purpose:
+ *  Drops the compressed copy of a freed swap slot, if any
+ *
+ * Args:
+ *  swap_idx {uint32_t} Swap slot
+ *
+ * Returns:
+ *  None
+ */
+void
+zswap_invalidate (uint32_t swap_idx)
+{
+  lock_acquire (&z_lock);
+
+  if (z_table[swap_idx] != NULL)
+  {
+    drop_entry (z_table[swap_idx]);
+  }
+
+  lock_release (&z_lock);
+}
+
+/**
+ * Purpose:
+ *  Prints compressed tier statistics at shutdown
+ *    * compressed size is given as a percentage of the stored pages'
+ *      size, zero pages included
+ *
+ * Args:
+ *  None
+ *
+ * Returns:
+ *  None
+ */
+void
+zswap_print_stats (void)
+{
+  printf ("Zswap: %lld pages stored, %lld zero, %lld incompressible, "
+          "%lld spilled\n",
+          z_store_cnt, z_zero_cnt, z_reject_cnt, z_spill_cnt);
+  printf ("Zswap: %lld%% compressed size, %lld hits of %lld swap-ins\n",
+          z_in_bytes != 0 ? z_out_bytes * 100 / z_in_bytes : 0,
+          z_hit_cnt, z_hit_cnt + z_miss_cnt);
+}
+
+/**
+ * Purpose:
+ *  Writes the oldest compressed page to its slot on disk and drops it
+ *    * must be called with `z_lock` held, which keeps readers of the
+ *      slot waiting until the disk copy is complete
+ *
+ * Args:
+ *  None
+ *
+ * Returns:
+ *  None
+ */
+static void
+spill_oldest (void)
+{
+  struct zswap_entry *e = list_entry (list_front (&z_fifo),
+                                      struct zswap_entry, elem);
+
+  lz_decompress (e->data, e->len, z_page);
+  swap_write (e->swap_idx, z_page);
+  z_spill_cnt++;
+
+  drop_entry (e);
+}
+
+/**
+ * Purpose:
+ *  Removes compressed page from the tier and frees it, must be called
+ *  with `z_lock` held
+ *
+ * Args:
+ *  e {zswap_entry*} Compressed page
+ *
+ * Returns:
+ *  None
+ */
+static void
+drop_entry (struct zswap_entry *e)
+{
+  list_remove (&e->elem);
+  z_table[e->swap_idx] = NULL;
+  z_bytes -= sizeof (struct zswap_entry) + e->len;
+  free (e);
+}
+
+/**
+ * Purpose:
+ *  Checks if every byte of a page is zero
+ *
+ * Args:
+ *  page {void*} Page
+ *
+ * Returns:
+ *  {bool} True for an all-zero page
+ */
+static bool
+is_zero_page (const void *page)
+{
+  const uint32_t *word = page;
+  size_t i;
+
+  for (i = 0; i < PGSIZE / sizeof *word; i++)
+  {
+    if (word[i] != 0)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * Purpose:
+ *  Compresses a page, greedy LZ77 with a one-entry hash match finder
+ *
+ * Args:
+ *  src {uint8_t*} Page to compress
+ *  dst {uint8_t*} Output buffer
+ *  max  {size_t} Size of output buffer
+ *
+ * Returns:
+ *  {size_t} Compressed length, 0 if it would exceed `max`
+ */
+static size_t
+lz_compress (const uint8_t *src, uint8_t *dst, size_t max)
+{
+  size_t ip = 0;
+  size_t op = 0;
+  size_t anchor = 0;
+
+  memset (lz_table, 0, sizeof lz_table);
+
+  while (ip + LZ_MIN_MATCH <= PGSIZE)
+  {
+    uint32_t h = lz_hash (src + ip);
+    size_t cand = lz_table[h];
+    lz_table[h] = ip + 1;
+
+    if (cand != 0 && memcmp (src + cand - 1, src + ip, LZ_MIN_MATCH) == 0)
+    {
+      size_t ref = cand - 1;
+      size_t n = LZ_MIN_MATCH;
+      while (ip + n < PGSIZE && n < LZ_MAX_MATCH && src[ref + n] == src[ip + n])
+      {
+        n++;
+      }
+
+      if (!lz_literals (src + anchor, ip - anchor, dst, &op, max)
+          || op + 3 > max)
+      {
+        return 0;
+      }
+
+      dst[op++] = 0x80 | (n - LZ_MIN_MATCH);
+      dst[op++] = (ip - ref) & 0xff;
+      dst[op++] = (ip - ref) >> 8;
+
+      ip += n;
+      anchor = ip;
+    }
+    else
+    {
+      ip++;
+    }
+  }
+
+  if (!lz_literals (src + anchor, PGSIZE - anchor, dst, &op, max))
+  {
+    return 0;
+  }
+
+  return op;
+}
+
+/**
+ * Purpose:
+ *  Emits a run of literal bytes as one or more literal tokens
+ *
+ * Args:
+ *  lit {uint8_t*} Literal bytes
+ *  n     {size_t} Number of literal bytes
+ *  dst {uint8_t*} Output buffer
+ *  op   {size_t*} Output position, advanced
+ *  max   {size_t} Size of output buffer
+ *
+ * Returns:
+ *  {bool} False if the output buffer is too small
+ */
+static bool
+lz_literals (const uint8_t *lit, size_t n, uint8_t *dst, size_t *op,
+             size_t max)
+{
+  while (n > 0)
+  {
+    size_t run = n < LZ_MAX_LITERAL ? n : LZ_MAX_LITERAL;
+    if (*op + 1 + run > max)
+    {
+      return false;
+    }
+
+    dst[(*op)++] = run - 1;
+    memcpy (dst + *op, lit, run);
+    *op += run;
+    lit += run;
+    n -= run;
+  }
+  return true;
+}
+
+/**
+ * Purpose:
+ *  Decompresses a page written by `lz_compress`, or zero-fills it for
+ *  an empty input
+ *
+ * Args:
+ *  src {uint8_t*} Compressed page
+ *  len   {size_t} Compressed length
+ *  dst {uint8_t*} Destination page
+ *
+ * Returns:
+ *  None
+ */
+static void
+lz_decompress (const uint8_t *src, size_t len, uint8_t *dst)
+{
+  size_t ip = 0;
+  size_t op = 0;
+
+  if (len == 0)
+  {
+    memset (dst, 0, PGSIZE);
+    return;
+  }
+
+  while (ip < len)
+  {
+    uint8_t c = src[ip++];
+    if (c < LZ_MAX_LITERAL)
+    {
+      size_t n = c + 1;
+      ASSERT (ip + n <= len && op + n <= PGSIZE);
+      memcpy (dst + op, src + ip, n);
+      ip += n;
+      op += n;
+    }
+    else
+    {
+      size_t n = (c & 0x7f) + LZ_MIN_MATCH;
+      size_t ofs = src[ip] | (src[ip + 1] << 8);
+      ip += 2;
+      ASSERT (ofs >= 1 && ofs <= op && op + n <= PGSIZE);
+
+      // byte at a time, a match may overlap its own output
+      while (n-- > 0)
+      {
+        dst[op] = dst[op - ofs];
+        op++;
+      }
+    }
+  }
+
+  ASSERT (op == PGSIZE);
+}
+
+/**
+ * Purpose:
+ *  Hashes the 3 bytes starting at `p` for the match finder
+ *
+ * Args:
+ *  p {uint8_t*} First byte
+ *
+ * Returns:
+ *  {uint32_t} Hash, below 1 << LZ_HASH_BITS
+ */
+static uint32_t
+lz_hash (const uint8_t *p)
+{
+  uint32_t x = p[0] | (p[1] << 8) | (p[2] << 16);
+  return (x * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
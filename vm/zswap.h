@@ -0,0 +1,73 @@
+#ifndef VM_ZSWAP_H
+#define VM_ZSWAP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Kernel pages the compressed tier may use, set by `-zswap=N`, 0 disables
+extern size_t zswap_max_pages;
+
+/**
+ * Purpose:
+ *  Initializes the compressed swap tier
+ *
+ * Args:
+ *  slot_cnt {size_t} Number of swap slots on the swap device
+ *
+ * Returns:
+ *  None
+ */
+void zswap_init (size_t slot_cnt);
+
+/**
+ * Purpose:
+ *  Stores page for a swap slot in compressed form, in RAM
+ *
+ * Args:
+ *  swap_idx {uint32_t} Swap slot reserved for the page
+ *  page        {void*} Page to store
+ *
+ * Returns:
+ *  {bool} True if stored, false if the page must be written to disk
+ */
+bool zswap_store (uint32_t swap_idx, const void *page);
+
+/**
+ * Purpose:
+ *  Reads page of a swap slot back from the compressed tier
+ *
+ * Args:
+ *  swap_idx {uint32_t} Swap slot
+ *  page        {void*} Destination page
+ *
+ * Returns:
+ *  {bool} True on a hit, false if the slot's page is on disk
+ */
+bool zswap_load (uint32_t swap_idx, void *page);
+
+/**
+ * Purpose:
+ *  Drops the compressed copy of a freed swap slot, if any
+ *
+ * Args:
+ *  swap_idx {uint32_t} Swap slot
+ *
+ * Returns:
+ *  None
+ */
+void zswap_invalidate (uint32_t swap_idx);
+
+/**
+ * Purpose:
+ *  Prints compressed tier statistics at shutdown
+ *
+ * Args:
+ *  None
+ *
+ * Returns:
+ *  None
+ */
+void zswap_print_stats (void);
+
+#endif /* vm/zswap.h */